@@ -19,11 +19,16 @@ Node::Node() {
     parent = NULL;
 }
 
-SymbolTable *Node::symtab = new SymbolTable;
-IRGenerator *Node::irgen = new IRGenerator;
-MyStack *Node::mystack = new MyStack;
-bool Node::hasReturned = false;
-FnDecl *Node::currFunc = NULL;
+void Node::EmitDebugLocation() {
+    if (location != NULL)
+        irgen->SetDebugLocation(location->first_line, location->first_column);
+}
+
+thread_local SymbolTable *Node::symtab = new SymbolTable;
+thread_local IRGenerator *Node::irgen = new IRGenerator;
+thread_local MyStack *Node::mystack = new MyStack;
+thread_local bool Node::hasReturned = false;
+thread_local FnDecl *Node::currFunc = NULL;
 
 
 /* The Print method is used to print the parse tree nodes.
@@ -53,11 +53,13 @@ class Node  {
   protected:
     yyltype *location;
     Node *parent;
-    static SymbolTable *symtab;
-    static bool hasReturned;
-    static MyStack *mystack;
-    static FnDecl *currFunc;
-    static IRGenerator *irgen;
+    // Per thread, so the parallel code generator (-j) can emit several
+    // functions at once, each into a module of its own
+    static thread_local SymbolTable *symtab;
+    static thread_local bool hasReturned;
+    static thread_local MyStack *mystack;
+    static thread_local FnDecl *currFunc;
+    static thread_local IRGenerator *irgen;
 
   public:
     Node(yyltype loc);
@@ -76,6 +78,9 @@ class Node  {
     virtual void PrintChildren(int indentLevel)  {}
 
     virtual llvm::Value* Emit() {return NULL;}
+
+    // -g: the instructions emitted next belong to this node's source line
+    void EmitDebugLocation();
 };
    
 
@@ -40,6 +40,14 @@ void VarDecl::PrintChildren(int indentLevel) {
    if (assignTo) assignTo->Print(indentLevel+1, "(initializer) ");
 }
 
+bool VarDecl::IsConst() const {
+    return typeq == TypeQualifier::constTypeQualifier;
+}
+
+bool VarDecl::IsUniform() const {
+    return typeq == TypeQualifier::uniformTypeQualifier;
+}
+
 llvm::Value* VarDecl::Emit() {
 
     Symbol* sym;
@@ -49,22 +57,25 @@ llvm::Value* VarDecl::Emit() {
  
 
     //Check if it was declared in the global variable.
-    if (symtab->isGlobalScope())  {
+    if (symtab->isGlobalScope() && IsConst())  {
+        val = EmitConstGlobal();
+    }
+    else if (symtab->isGlobalScope())  {
         val = new llvm::GlobalVariable( *MOD,
                                         type -> GetllvmType(),
                                         false,
                                         llvm::GlobalValue::ExternalLinkage,
-                                        llvm::Constant::getNullValue(type -> GetllvmType()),
+                                        EmitInitializer(),
                                         *twine
                                       );   
     }
     else   {
-        //Insert the variable at the end of the current block.
-        llvm::BasicBlock* blk = irgen->GetBasicBlock();
-        val = new llvm::AllocaInst(type -> GetllvmType(),*twine, blk);
+        //Hoist the variable into the entry block of the function.
+        val = irgen->CreateEntryBlockAlloca(type -> GetllvmType(), GetIdentifier()->GetName());
     }
 
     sym = new Symbol(GetIdentifier() -> GetName(),this, E_VarDecl, val);
+    sym -> uniform = IsUniform();
     symtab -> insert(*sym);
     
 
@@ -73,6 +84,76 @@ llvm::Value* VarDecl::Emit() {
 }
 
 
+// The global itself is defined in the main module; this only refers to it.
+// A const global is internal to every module, so each gets its own copy.
+llvm::Value* VarDecl::EmitDeclaration() {
+
+    llvm::Module* MOD = irgen -> GetOrCreateModule("");
+    llvm::Value* val = NULL;
+
+    if (IsConst())
+        val = EmitConstGlobal();
+    else
+        val = new llvm::GlobalVariable( *MOD,
+                                        type -> GetllvmType(),
+                                        false,
+                                        llvm::GlobalValue::ExternalLinkage,
+                                        NULL,
+                                        GetIdentifier()->GetName()
+                                      );
+
+    Symbol* sym = new Symbol(GetIdentifier() -> GetName(),this, E_VarDecl, val);
+    sym -> uniform = IsUniform();
+    symtab -> insertGlobal(*sym);
+
+    return val;
+}
+
+
+
+
+
+
+
+// A const global is a constant only this module can see; VarExpr::Emit
+// folds its loads to the initializer.
+llvm::GlobalVariable* VarDecl::EmitConstGlobal() {
+
+    llvm::Module* MOD = irgen -> GetOrCreateModule("");
+
+    return new llvm::GlobalVariable( *MOD,
+                                     type -> GetllvmType(),
+                                     true,
+                                     llvm::GlobalValue::InternalLinkage,
+                                     EmitInitializer(),
+                                     GetIdentifier()->GetName()
+                                   );
+}
+
+
+// Global initializers are emitted outside of any function, so only a
+// constant expression comes out as a value here.
+llvm::Constant* VarDecl::EmitInitializer() {
+
+    llvm::Type* ty = type -> GetllvmType();
+    if (assignTo == NULL)  {
+        if (IsConst())
+            Failure("const %s has no initializer", GetIdentifier()->GetName());
+        return llvm::Constant::getNullValue(ty);
+    }
+
+    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
+    irgen -> SetBasicBlock(NULL);
+    llvm::Constant* init = llvm::dyn_cast<llvm::Constant>(assignTo -> Emit());
+    irgen -> SetBasicBlock(currBlk);
+
+    if (init == NULL || init -> getType() != ty)
+        Failure("initializer of global %s is not a constant of its type", GetIdentifier()->GetName());
+
+    return init;
+}
+
+
 
 
 
@@ -84,6 +165,7 @@ FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(n) {
     (formals=d)->SetParentAll(this);
     body = NULL;
     returnTypeq = NULL;
+    inlineHint = 0;
 }
 
 FnDecl::FnDecl(Identifier *n, Type *r, TypeQualifier *rq, List<VarDecl*> *d) : Decl(n) {
@@ -92,6 +174,7 @@ FnDecl::FnDecl(Identifier *n, Type *r, TypeQualifier *rq, List<VarDecl*> *d) : D
     (returnTypeq=rq)->SetParent(this);
     (formals=d)->SetParentAll(this);
     body = NULL;
+    inlineHint = 0;
 }
 
 void FnDecl::SetFunctionBody(Stmt *b) { 
@@ -106,10 +189,8 @@ void FnDecl::PrintChildren(int indentLevel) {
 }
 
 
-llvm::Value* FnDecl::Emit()  {
-
+llvm::Function* FnDecl::EmitPrototype()  {
 
-    Symbol *sym;
     llvm::Module* mod = irgen -> GetOrCreateModule("test.bc");
 
     // Get llvmType of return type
@@ -118,6 +199,10 @@ llvm::Value* FnDecl::Emit()  {
 
     //Set up parameter list
     vector<llvm::Type*> param;
+
+    // SPMD: the caller's execution mask comes first
+    if(irgen -> IsSPMD())
+        param.push_back(irgen -> GetBoolType());
     
     for(int i = 0; i < formals -> NumElements(); i++) {
         
@@ -133,7 +218,13 @@ llvm::Value* FnDecl::Emit()  {
 
     //Set and get Function from Module
     llvm::Function* func = llvm::cast<llvm::Function>(mod -> getOrInsertFunction(id->GetName(),funcType));
-    irgen -> SetFunction(func);
+    irgen -> AddTargetAttributes(func);
+
+    // #pragma inline / noinline
+    if(inlineHint > 0)
+        func -> addFnAttr(llvm::Attribute::AlwaysInline);
+    else if(inlineHint < 0)
+        func -> addFnAttr(llvm::Attribute::NoInline);
    
 
 
@@ -141,6 +232,11 @@ llvm::Value* FnDecl::Emit()  {
     llvm::Function::arg_iterator argIt = func -> arg_begin();
     int i = 0;
 
+    if(irgen -> IsSPMD())  {
+        argIt->setName("mask");
+        argIt++;
+    }
+
     for(argIt; argIt != func->arg_end(); argIt++) {
         VarDecl *vdecl = formals -> Nth(i);
 
@@ -149,21 +245,40 @@ llvm::Value* FnDecl::Emit()  {
         i++;
     }
 
+    return func;
+}
+
+
+
+llvm::Value* FnDecl::Emit()  {
+
+
+    Symbol *sym;
+
+    llvm::Function* func = EmitPrototype();
+    llvm::Type* retType = func -> getReturnType();
+    irgen -> SetFunction(func);
+
 
     //Create Entry Block
     llvm::LLVMContext *con = irgen -> GetContext();
     llvm::BasicBlock *blk = llvm::BasicBlock::Create(*con,"entry",func);
     irgen -> SetBasicBlock(blk);
+    irgen -> CountBlock(blk);
+    irgen -> CreateSubprogram(func, location->first_line);
 
     
     symtab -> push();
 
 
     //Emit Formals onto the entry block
-    argIt = func -> arg_begin();
-    i = 0;
+    llvm::Function::arg_iterator argIt = func -> arg_begin();
+    int i = 0;
     Symbol* tempSym = NULL;
 
+    if(irgen -> IsSPMD())
+        argIt++;
+
 
     for(argIt; argIt != func->arg_end(); argIt++) {
         llvm::Value* vVal = formals->Nth(i)->Emit();
@@ -183,12 +298,52 @@ llvm::Value* FnDecl::Emit()  {
     irgen->SetBasicBlock(nextBlk);
 */
 
+    // SPMD: lanes start out live as given by the mask argument; a return
+    // stores its value under the mask and kills the lanes that ran it
+    if(irgen -> IsSPMD())  {
+        irgen -> liveSlot = irgen -> CreateEntryBlockAlloca(irgen->GetBoolType(),"live");
+        new llvm::StoreInst(&*func->arg_begin(), irgen->liveSlot, irgen->GetBasicBlock());
+
+        irgen -> retSlot = NULL;
+        if(retType != NULL && !retType->isVoidTy())
+            irgen -> retSlot = irgen -> CreateEntryBlockAlloca(retType,"retval");
+
+        irgen -> PushMask(llvm::Constant::getAllOnesValue(irgen->GetBoolType()));
+        irgen -> PushKillSlot(irgen->liveSlot);
+    }
+
     // Emit Body
     body -> Emit();
 
+    if(irgen -> IsSPMD())  {
+        irgen -> PopKillSlot();
+        irgen -> PopMask();
+
+        llvm::BasicBlock* endBlk = irgen -> GetBasicBlock();
+        if(irgen->retSlot != NULL)
+            llvm::ReturnInst::Create(*con, new llvm::LoadInst(irgen->retSlot,"",endBlk), endBlk);
+        else
+            llvm::ReturnInst::Create(*con, endBlk);
+    }
+    irgen -> TerminateOpenBlocks(func);
+    irgen -> FinishFunction();
+
     symtab -> pop();
     sym = new Symbol(GetIdentifier()->GetName(),this,E_FunctionDecl,func);
     symtab -> insert(*sym);
 
     return func;
 }
+
+
+
+// Called for a function defined in another module
+llvm::Value* FnDecl::EmitDeclaration()  {
+
+    llvm::Function* func = EmitPrototype();
+
+    Symbol* sym = new Symbol(GetIdentifier()->GetName(),this,E_FunctionDecl,func);
+    symtab -> insertGlobal(*sym);
+
+    return func;
+}
@@ -37,6 +37,10 @@ class Decl : public Node
     friend ostream& operator<<(ostream& out, Decl *d) { return out << d->id; }
     virtual llvm::Value* Emit() {return NULL;}
 
+    // Declares (without defining) a global or function emitted in another
+    // module and adds it to the global scope
+    virtual llvm::Value* EmitDeclaration() {return NULL;}
+
 };
 
 class VarDecl : public Decl 
@@ -54,8 +58,16 @@ class VarDecl : public Decl
     const char *GetPrintNameForNode() { return "VarDecl"; }
     void PrintChildren(int indentLevel);
     Type *GetType() const { return type; }
+    TypeQualifier *GetTypeQualifier() const { return typeq; }
+    bool IsConst() const;
+    bool IsUniform() const;
 
     virtual llvm::Value* Emit();
+    virtual llvm::Value* EmitDeclaration();
+
+  protected:
+    llvm::GlobalVariable* EmitConstGlobal();
+    llvm::Constant* EmitInitializer();
 };
 
 class VarDeclError : public VarDecl
@@ -72,19 +84,23 @@ class FnDecl : public Decl
     Type *returnType;
     TypeQualifier *returnTypeq;
     Stmt *body;
+    int inlineHint;     // #pragma inline (1) or noinline (-1), 0 if none
     
   public:
-    FnDecl() : Decl(), formals(NULL), returnType(NULL), returnTypeq(NULL), body(NULL) {}
+    FnDecl() : Decl(), formals(NULL), returnType(NULL), returnTypeq(NULL), body(NULL), inlineHint(0) {}
     FnDecl(Identifier *name, Type *returnType, List<VarDecl*> *formals);
     FnDecl(Identifier *name, Type *returnType, TypeQualifier *returnTypeq, List<VarDecl*> *formals);
     void SetFunctionBody(Stmt *b);
+    void SetInlineHint(int hint) { inlineHint = hint; }
     const char *GetPrintNameForNode() { return "FnDecl"; }
     void PrintChildren(int indentLevel);
 
     Type *GetType() const { return returnType; }
     List<VarDecl*> *GetFormals() {return formals;}
 
+    llvm::Function* EmitPrototype();
     virtual llvm::Value* Emit();
+    virtual llvm::Value* EmitDeclaration();
 };
 
 class FormalsError : public FnDecl
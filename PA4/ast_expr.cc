@@ -73,14 +73,21 @@ void VarExpr::PrintChildren(int indentLevel) {
 llvm::Value* VarExpr::Emit() {
     Symbol *sym;
     llvm::Value* val;
-    llvm::BasicBlock* blk = irgen -> GetBasicBlock();
 
     sym = symtab -> findall(id->GetName());
     if(sym == NULL) 
         return NULL;
      
-
-    val = new llvm::LoadInst(sym->value,id->GetName(),blk);
+    //A const global is its initializer
+    llvm::GlobalVariable* gv = llvm::dyn_cast<llvm::GlobalVariable>(sym->value);
+    if(gv != NULL && gv -> isConstant())
+        return gv -> getInitializer();
+
+    //The shader never writes a uniform, so one load per function serves
+    if(sym -> uniform)
+        val = irgen -> LoadUniform(sym->value,id->GetName());
+    else
+        val = irgen -> LoadVariable(sym->value,id->GetName());
     return val;
     
 }
@@ -130,49 +137,90 @@ void CompoundExpr::PrintChildren(int indentLevel) {
    op->Print(indentLevel+1);
    if (right) right->Print(indentLevel+1);
 }
+
+bool CompoundExpr::HasSideEffects() {
+    return (left && left->HasSideEffects()) || (right && right->HasSideEffects());
+}
+
+int CompoundExpr::GetCost() {
+    return (left ? left->GetCost() : 0) + (right ? right->GetCost() : 0) + 1;
+}
+
+// Prefix ++ and -- store their result back into the operand
+bool ArithmeticExpr::HasSideEffects() {
+    return (left == NULL && (op->IsOp("++") || op->IsOp("--"))) || CompoundExpr::HasSideEffects();
+}
+
+// Division may trap (integer divide by zero) and is slow either way
+int ArithmeticExpr::GetCost() {
+    if(op->IsOp("/"))
+        return NotSpeculatable;
+    return CompoundExpr::GetCost();
+}
    
 
 
+// The location the lvalue expr was loaded from (val). Const globals come
+// back as their value and uniforms are marked in the symbol table; neither
+// may be assigned.
+static llvm::Value* LvalueAddress(SymbolTable* symtab, Expr* expr, llvm::Value* val) {
+    VarExpr* var = dynamic_cast<VarExpr*>(expr);
+    Symbol* sym = (var != NULL ? symtab -> findall(var->GetIdentifier()->GetName()) : NULL);
+    if(sym != NULL && sym -> uniform)
+        Failure("cannot assign to uniform %s", sym->name);
+
+    llvm::LoadInst* load = llvm::dyn_cast<llvm::LoadInst>(val);
+    if(load == NULL)
+        Failure("cannot assign to a constant");
+
+    return load -> getPointerOperand();
+}
+
+
+
 llvm::Value* ArithmeticExpr::Emit() {
     llvm::Value* rhs = right -> Emit();
-    llvm::LoadInst* rhsLoc = llvm::cast<llvm::LoadInst>(rhs);
-
     llvm::Value* lhs = NULL;
 
     llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
     FieldAccess* faL = dynamic_cast<FieldAccess*>(left);
     FieldAccess* faR = dynamic_cast<FieldAccess*>(right);
 
-    //Unary Operations (++ , --)
+    //Unary Operations (++ , -- , + , -)
     if(left == NULL && right != NULL)  {
+        // ++ and -- store their result back into the operand; - and +
+        // only give a value
+        llvm::Value* rhsLoc = NULL;
+        if(op -> IsOp("++") || op -> IsOp("--"))
+            rhsLoc = LvalueAddress(symtab,right,rhs);
+
         if(rhs->getType() == irgen->GetIntType()) {
             llvm::Value *inc = llvm::ConstantInt::get(irgen->GetIntType(),1);
 
 
             if(op -> IsOp("++")) {                
-                llvm::Value* sum = llvm::BinaryOperator::CreateAdd(rhs,inc,"",currBlk);
+                llvm::Value* sum = irgen -> Builder().CreateAdd(rhs,inc);
 
-                new llvm::StoreInst(sum,rhsLoc->getPointerOperand(),currBlk);
+                if(rhsLoc)
+                    irgen -> CreateStore(sum,rhsLoc,currBlk);
                 return sum;
             }
             else if(op->IsOp("--")){
-                llvm::Value* dif = llvm::BinaryOperator::CreateSub(rhs,inc,"",currBlk);
+                llvm::Value* dif = irgen -> Builder().CreateSub(rhs,inc);
 
-                new llvm::StoreInst(dif,rhsLoc->getPointerOperand(),currBlk);
+                if(rhsLoc)
+                    irgen -> CreateStore(dif,rhsLoc,currBlk);
                 return dif;
             }
             else if(op->IsOp("+"))  {
-                llvm::Value* pos = llvm::BinaryOperator::CreateMul(rhs,inc,"",currBlk);
+                llvm::Value* pos = irgen -> Builder().CreateMul(rhs,inc);
 
-                new llvm::StoreInst(pos,rhsLoc->getPointerOperand(),currBlk);
                 return pos;
             }
             else if(op->IsOp("-"))  {
                 llvm::Value* zero = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                llvm::Value* neg = llvm::BinaryOperator::CreateSub(zero,rhs,"",currBlk);
+                llvm::Value* neg = irgen -> Builder().CreateSub(zero,rhs);
 
-
-                new llvm::StoreInst(neg,rhsLoc->getPointerOperand(),currBlk);
                 return neg;
             }
         }
@@ -181,28 +229,28 @@ llvm::Value* ArithmeticExpr::Emit() {
             
 
             if(op->IsOp("++"))  {
-                 llvm::Value* fSum = llvm::BinaryOperator::CreateFAdd(rhs,fInc,"",currBlk);
+                 llvm::Value* fSum = irgen -> Builder().CreateFAdd(rhs,fInc);
         
-                new llvm::StoreInst(fSum,rhsLoc->getPointerOperand(),currBlk);
+                if(rhsLoc)
+                    irgen -> CreateStore(fSum,rhsLoc,currBlk);
                 return  fSum;
             }
             else if(op->IsOp("--"))  {
-                llvm::Value* fDiff = llvm::BinaryOperator::CreateFSub(rhs,fInc,"",currBlk);
+                llvm::Value* fDiff = irgen -> Builder().CreateFSub(rhs,fInc);
 
-                new llvm::StoreInst(fDiff,rhsLoc->getPointerOperand(),currBlk);
+                if(rhsLoc)
+                    irgen -> CreateStore(fDiff,rhsLoc,currBlk);
                 return fDiff;
             }
             else if(op->IsOp("+"))  {
-                llvm::Value* Fpos = llvm::BinaryOperator::CreateFMul(rhs,fInc,"",currBlk);
+                llvm::Value* Fpos = irgen -> Builder().CreateFMul(rhs,fInc);
 
-                new llvm::StoreInst(Fpos,rhsLoc->getPointerOperand(),currBlk);
                 return Fpos;
             }
             else if(op->IsOp("-"))  {
                 llvm::Value* zero = llvm::ConstantFP::get(irgen->GetFloatType(),0.0);
-                llvm::Value* Fneg = llvm::BinaryOperator::CreateFSub(zero,rhs,"",currBlk);
+                llvm::Value* Fneg = irgen -> Builder().CreateFSub(zero,rhs);
 
-                new llvm::StoreInst(Fneg,rhsLoc->getPointerOperand(),currBlk);
                 return Fneg;
             }
 
@@ -217,29 +265,31 @@ llvm::Value* ArithmeticExpr::Emit() {
     //Binary Operations
     if(left != NULL && right != NULL)  {
         lhs = left -> Emit();
-        llvm::LoadInst* lhsLoc = llvm::cast<llvm::LoadInst>(lhs);
+        currBlk = irgen -> GetBasicBlock();
+        IRGenerator::FoldingBuilder& builder = irgen -> Builder();
 
 
 
         // INT BINARY OPERATIONS
         if(lhs->getType() == irgen->GetIntType() && rhs->getType() == irgen->GetIntType()) {
             if(op->IsOp("+")) {
-                llvm::Value* sum  = llvm::BinaryOperator::CreateAdd(lhs,rhs,"",currBlk);
+                llvm::Value* sum  = builder.CreateAdd(lhs,rhs);
 
                 return sum;
             }
             else if(op->IsOp("-"))  {
-                llvm::Value* dif = llvm::BinaryOperator::CreateSub(lhs,rhs,"",currBlk);
+                llvm::Value* dif = builder.CreateSub(lhs,rhs);
 
                 return dif;
             }
             else if(op->IsOp("*")) {
-                llvm::Value* prod = llvm::BinaryOperator::CreateMul(lhs,rhs,"",currBlk);
+                llvm::Value* prod = builder.CreateMul(lhs,rhs);
 
                 return prod;
             }
             else if(op->IsOp("/"))  {
-                llvm::Value* quot = llvm::BinaryOperator::CreateSDiv(lhs,rhs,"",currBlk);
+                rhs = irgen -> GuardDivisor(rhs,currBlk);
+                llvm::Value* quot = irgen -> Builder().CreateSDiv(lhs,rhs);
 
                 return quot;
             }
@@ -256,22 +306,22 @@ llvm::Value* ArithmeticExpr::Emit() {
                 )
                )  {
             if(op->IsOp("+"))  {
-                llvm::Value* Fsum = llvm::BinaryOperator::CreateFAdd(lhs,rhs,"",currBlk);
+                llvm::Value* Fsum = builder.CreateFAdd(lhs,rhs);
 
                 return Fsum;
             }
             else if(op->IsOp("-"))  {
-                llvm::Value* Fdif = llvm::BinaryOperator::CreateFSub(lhs,rhs,"",currBlk);
+                llvm::Value* Fdif = builder.CreateFSub(lhs,rhs);
 
                 return Fdif;
             }
             else if(op->IsOp("*"))  {
-                llvm::Value* Fmul = llvm::BinaryOperator::CreateFMul(lhs,rhs,"",currBlk);
+                llvm::Value* Fmul = builder.CreateFMul(lhs,rhs);
 
                 return Fmul;
             }
             else if(op->IsOp("/"))  {
-                llvm::Value* Fdiv = llvm::BinaryOperator::CreateFDiv(lhs,rhs,"",currBlk);
+                llvm::Value* Fdiv = builder.CreateFDiv(lhs,rhs);
 
                 return Fdiv;
             }
@@ -280,64 +330,30 @@ llvm::Value* ArithmeticExpr::Emit() {
         }
         //FLOAT VEC / VEC FLOAT BINARY OPERATIONS
         else  {
-            llvm::Value* vec;
-            llvm::Value* idx;
-            int vecType;
-
-             // CREATE VECTOR FILLED WITH FLOATS
-            if(lhs->getType() == irgen->GetFloatType())  {
-                vec = llvm::UndefValue::get(rhs->getType());
-
-                if(rhs->getType() == irgen->GetVec2Type())
-                    vecType = 2;
-                else if(rhs->getType() == irgen->GetVec3Type())
-                    vecType = 3;
-                else
-                    vecType = 4;
-            
-                for(int i = 0; i < vecType; i++) {
-                    idx = llvm::ConstantInt::get(irgen->GetIntType(),i);
-
-                    vec = llvm::InsertElementInst::Create(vec,lhs,idx,"",currBlk);
-                }
-                lhs = vec;       
-            }
-            else  {
-                vec = llvm::UndefValue::get(lhs->getType());
-
-                if(lhs->getType() == irgen->GetVec2Type())
-                    vecType = 2;
-                else if(lhs->getType() == irgen->GetVec3Type())
-                    vecType = 3;
-                else
-                    vecType = 4;
-
-                for(int i = 0; i < vecType; i++)  {
-                    idx = llvm::ConstantInt::get(irgen->GetIntType(),i);
-   
-                    vec = llvm::InsertElementInst::Create(vec,rhs,idx,"",currBlk);
-                }
-                rhs = vec;
-            }
+             // SPLAT THE FLOAT ACROSS THE VECTOR
+            if(lhs->getType() == irgen->GetFloatType())
+                lhs = irgen -> CreateSplat(lhs,rhs->getType(),currBlk);
+            else
+                rhs = irgen -> CreateSplat(rhs,lhs->getType(),currBlk);
 
 
             if(op->IsOp("+"))  {
-                llvm::Value* Fsum = llvm::BinaryOperator::CreateFAdd(lhs,rhs,"",currBlk);
+                llvm::Value* Fsum = builder.CreateFAdd(lhs,rhs);
 
                 return Fsum;
             }
             else if(op->IsOp("-"))  {
-                llvm::Value* Fdif = llvm::BinaryOperator::CreateFSub(lhs,rhs,"",currBlk);
+                llvm::Value* Fdif = builder.CreateFSub(lhs,rhs);
 
                 return Fdif;
             }
             else if(op->IsOp("*"))  {
-                llvm::Value* Fmul = llvm::BinaryOperator::CreateFMul(lhs,rhs,"",currBlk);
+                llvm::Value* Fmul = builder.CreateFMul(lhs,rhs);
 
                 return Fmul;
             }
             else if(op->IsOp("/"))  {
-                llvm::Value* Fdiv = llvm::BinaryOperator::CreateFDiv(lhs,rhs,"",currBlk);
+                llvm::Value* Fdiv = builder.CreateFDiv(lhs,rhs);
 
                 return Fdiv;
             }
@@ -358,7 +374,6 @@ llvm::Value* ArithmeticExpr::Emit() {
 
 
 llvm::Value* RelationalExpr::Emit() {
-    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
     llvm::Value* lhs = left -> Emit();
     llvm::Value* rhs = right -> Emit();
     llvm::Value* res = NULL;
@@ -377,7 +392,7 @@ llvm::Value* RelationalExpr::Emit() {
         else //Should never reach here
             return NULL;
         
-        res = llvm::CmpInst::Create(llvm::CmpInst::ICmp,pred,lhs,rhs,"",currBlk);
+        res = irgen -> Builder().CreateICmp(pred,lhs,rhs);
     }
     //FLOAT FLOAT COMPARISONs
     else  { //ASSUMING THAT BOTH LHS AND RHS WILL BE FLOAT
@@ -391,7 +406,7 @@ llvm::Value* RelationalExpr::Emit() {
             pred = llvm::CmpInst::FCMP_OLE;
         else NULL;
 
-        res = llvm::CmpInst::Create(llvm::CmpInst::FCmp,pred,lhs,rhs,"",currBlk);
+        res = irgen -> Builder().CreateFCmp(pred,lhs,rhs);
 
     }
 
@@ -404,7 +419,6 @@ llvm::Value* RelationalExpr::Emit() {
 
 
 llvm::Value* EqualityExpr::Emit()  {
-    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
     llvm::Value* lhs = left->Emit();
     llvm::Value* rhs = right->Emit();
     llvm::Value* res = NULL;
@@ -420,7 +434,7 @@ llvm::Value* EqualityExpr::Emit()  {
         else
             return NULL;
 
-        res = llvm::CmpInst::Create(llvm::CmpInst::ICmp,pred,lhs,rhs,"",currBlk);
+        res = irgen -> Builder().CreateICmp(pred,lhs,rhs);
     }
     //FLOAT FLOAT EQUALITY COMPARISON
     else if(lhs->getType() == irgen->GetFloatType() && rhs->getType() == irgen->GetFloatType())  {
@@ -431,7 +445,7 @@ llvm::Value* EqualityExpr::Emit()  {
         else
             return NULL;
 
-        res = llvm::CmpInst::Create(llvm::CmpInst::FCmp,pred,lhs,rhs,"",currBlk);
+        res = irgen -> Builder().CreateFCmp(pred,lhs,rhs);
     }
 
 
@@ -442,774 +456,192 @@ llvm::Value* EqualityExpr::Emit()  {
 
 
 
+// A right operand that is cheap and cannot have side effects (or trap) is
+// evaluated unconditionally and combined with a select, which avoids a
+// branch. Anything else is guarded by a conditional branch and the result
+// is merged with a phi, so "a || f()" never calls f() when a is true.
 llvm::Value* LogicalExpr::Emit() {
-    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
+    llvm::LLVMContext* con = irgen -> GetContext();
+    llvm::Function* func = irgen -> GetFunction();
+
     llvm::Value* lhs = left -> Emit();
-    llvm::Value* rhs = right -> Emit();
-    llvm::Value* res = NULL;
+    bool isAnd = op->IsOp("&&");   // Assuming that it will be || otherwise
 
-    if(op->IsOp("&&"))  
-        res = llvm::BinaryOperator::CreateAnd(lhs,rhs,"",currBlk);
-    else  // Assuming that it will be ||
-        res = llvm::BinaryOperator::CreateOr(lhs,rhs,"",currBlk);
-    
-    return res;
-}
+    llvm::Constant* shortVal = llvm::ConstantInt::get(irgen->GetBoolType(), isAnd ? 0 : 1);
 
+    //Branchless Select
+    if(!right->HasSideEffects() && right->GetCost() <= MaxSelectCost)  {
+        llvm::Value* rhs = right -> Emit();
 
+        if(isAnd)
+            return irgen -> Builder().CreateSelect(lhs,rhs,shortVal);
+        else
+            return irgen -> Builder().CreateSelect(lhs,shortVal,rhs);
+    }
 
+    //SPMD: there is no per-lane branch, so the right operand runs with
+    //the lanes that still need it (lhs true for &&, false for ||) enabled
+    if(irgen->IsSPMD())  {
+        llvm::Value* need = isAnd ? lhs : irgen -> Builder().CreateNot(lhs);
+        llvm::Value* mask = irgen -> GetMask();
+        irgen -> PushMask(irgen -> Builder().CreateAnd(mask,need));
+        llvm::Value* rhs = right -> Emit();
+        irgen -> PopMask();
+
+        if(isAnd)
+            return irgen -> Builder().CreateSelect(lhs,rhs,shortVal);
+        else
+            return irgen -> Builder().CreateSelect(lhs,shortVal,rhs);
+    }
 
-llvm::Value* AssignExpr::Emit()  {
-    Symbol* Rsym = NULL;
+    //Short Circuit
+    llvm::BasicBlock* lhsBlk = irgen -> GetBasicBlock();
+    llvm::BasicBlock* rhsBlk = llvm::BasicBlock::Create(*con,"LOGrhs",func);
+    llvm::BasicBlock* footBlk = llvm::BasicBlock::Create(*con,"LOGfooter",func);
 
-    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
+    if(isAnd)
+        irgen -> Builder().CreateCondBr(lhs,rhsBlk,footBlk);
+    else
+        irgen -> Builder().CreateCondBr(lhs,footBlk,rhsBlk);
+
+    irgen -> SetBasicBlock(rhsBlk);
     llvm::Value* rhs = right -> Emit();
+    llvm::BasicBlock* rhsEnd = irgen -> GetBasicBlock();
+    irgen -> Builder().CreateBr(footBlk);
 
+    irgen -> SetBasicBlock(footBlk);
+    llvm::PHINode* res = irgen -> Builder().CreatePHI(irgen->GetBoolType(),2);
+    res -> addIncoming(shortVal,lhsBlk);
+    res -> addIncoming(rhs,rhsEnd);
 
-    FieldAccess* faR = dynamic_cast<FieldAccess*>(right);
-    FieldAccess* faL = dynamic_cast<FieldAccess*>(left);
-    char* rSwizz = NULL;
-    int swizLen = 0; 
-    
-    if(faR){
-        rSwizz = faR -> GetField() -> GetName();
-        int swizLen = strlen(rSwizz);
-    }
+    return res;
+}
 
 
 
-    //Left Side is a regular variable
-    //Assuming that type is the same.
-    if(faL == NULL)  {
-        llvm::Value* lhs = left -> Emit();
 
-        llvm::LoadInst* lhsInst = llvm::cast<llvm::LoadInst>(lhs);
-        llvm::Value* lhsLoc = lhsInst -> getPointerOperand();
+// Applies the arithmetic part of a compound assignment ("+=" -> "+").
+// A scalar operand is broadcast when the other side is a vector.
+static llvm::Value* EmitCompoundOp(IRGenerator* irgen, Operator* op, llvm::Value* lhs,
+                                   llvm::Value* rhs, llvm::BasicBlock* currBlk) {
+    if(lhs->getType()->isVectorTy() && !rhs->getType()->isVectorTy())
+        rhs = irgen -> CreateSplat(rhs,lhs->getType(),currBlk);
 
+    bool isInt = (lhs->getType() == irgen->GetIntType());
 
-        // Right side is a regular variable
-        if(op->IsOp("="))  {
-           new llvm::StoreInst(rhs,lhsLoc,currBlk);
-        }
-        else if(op->IsOp("+="))  {
-            llvm::Value* sum;
+    if(isInt && op->IsOp("/="))
+        rhs = irgen -> GuardDivisor(rhs,currBlk);
 
-            if(lhs->getType() == irgen->GetIntType())
-                sum = llvm::BinaryOperator::CreateAdd(lhs,rhs,"",currBlk);
-            else
-                sum = llvm::BinaryOperator::CreateFAdd(lhs,rhs,"",currBlk);
+    IRGenerator::FoldingBuilder& builder = irgen -> Builder();
+    if(op->IsOp("+="))
+        return isInt ? builder.CreateAdd(lhs,rhs) : builder.CreateFAdd(lhs,rhs);
+    else if(op->IsOp("-="))
+        return isInt ? builder.CreateSub(lhs,rhs) : builder.CreateFSub(lhs,rhs);
+    else if(op->IsOp("*="))
+        return isInt ? builder.CreateMul(lhs,rhs) : builder.CreateFMul(lhs,rhs);
+    else if(op->IsOp("/="))
+        return isInt ? builder.CreateSDiv(lhs,rhs) : builder.CreateFDiv(lhs,rhs);
 
-            new llvm::StoreInst(sum,lhsLoc,currBlk);
-        }
-        else if(op->IsOp("-="))  {
-            llvm::Value* dif;
-                
-            if(lhs->getType() == irgen->GetIntType())
-                dif = llvm::BinaryOperator::CreateSub(lhs,rhs,"",currBlk);
-            else
-                dif = llvm::BinaryOperator::CreateFSub(lhs,rhs,"",currBlk);
+    // "="
+    return rhs;
+}
 
-            new llvm::StoreInst(dif,lhsLoc,currBlk);
-        }
-        else if(op->IsOp("*="))  {
-            llvm::Value* prod;
-        
-            if(lhs->getType() == irgen->GetIntType())
-                prod = llvm::BinaryOperator::CreateFMul(lhs,rhs,"",currBlk);
-            else
-                prod = llvm::BinaryOperator::CreateFMul(lhs,rhs,"",currBlk);
 
-            new llvm::StoreInst(prod,lhsLoc,currBlk);
-        }
-        else if(op->IsOp("/="))  {
-            llvm::Value* quot;
- 
-            if(lhs->getType() == irgen->GetIntType())
-                quot = llvm::BinaryOperator::CreateSDiv(lhs,rhs,"",currBlk);
-            else
-                quot = llvm::BinaryOperator::CreateFDiv(lhs,rhs,"",currBlk);
+llvm::Value* AssignExpr::Emit()  {
+    llvm::Value* rhs = right -> Emit();
+    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
+    llvm::Value* val = NULL;
 
-            new llvm::StoreInst(quot,lhsLoc,currBlk);
-        }
+    FieldAccess* faL = dynamic_cast<FieldAccess*>(left);
+
+    //Left Side is a regular variable
+    if(faL == NULL)  {
+        llvm::Value* lhs = left -> Emit();
+        currBlk = irgen -> GetBasicBlock();
+
+        llvm::Value* lhsLoc = LvalueAddress(symtab,left,lhs);
+
+        val = EmitCompoundOp(irgen,op,lhs,rhs,currBlk);
+        irgen -> CreateStore(val,lhsLoc,currBlk);
     }
 
     // LEFT IS A Field Access
+    // Load the base vector once, compute the swizzled lanes, then blend
+    // them back into the vector with a single shuffle and store.
     else {
-        Symbol* sym;
-        llvm::Value* lhsLoc;
-        llvm::Value* value;
-        llvm::Constant* idx;
-
         char* lSwizz = faL -> GetField() -> GetName();
-        int swLength = strlen(lSwizz);
-
-        VarExpr* baseAddr = dynamic_cast<VarExpr*>(faL->GetBase());
-        sym = symtab->findall(baseAddr->GetIdentifier()->GetName());
-
-        //Right side is a variable
-        if(faR == NULL) {
-                        
-            if(op->IsOp("="))  {
-                
-                if(rhs->getType() == irgen->GetFloatType())  {                
-                    if(lSwizz[0] == 'x')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                    else if(lSwizz[0] == 'y')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                    else if(lSwizz[0] == 'z')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                    else
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                    lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                    value = llvm::InsertElementInst::Create(lhsLoc,rhs,idx,"",currBlk);
-                    new llvm::StoreInst(value,sym->value,"",currBlk);
-                }
-                else {
-                    llvm::Value* rhsVal;
-                    llvm::Constant* rhsIdx;
-                    llvm::Value* leftAddr = sym->value;
-
-                    for(int i = 0; i < swLength; i++)  {
- 
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),i);
-                        rhsVal = llvm::ExtractElementInst::Create(rhs,rhsIdx,"",currBlk);
-
-                        if(lSwizz[i] == 'x')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                        else if(lSwizz[i] == 'y')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                        else if(lSwizz[i] == 'z')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                        else
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                        lhsLoc = new llvm::LoadInst(leftAddr,"",currBlk);
-                        value = llvm::InsertElementInst::Create(lhsLoc,rhsVal,idx,"",currBlk);
-                        new llvm::StoreInst(value,leftAddr,"",currBlk);
-                    }
-                }
-            } // "="
-            else if(op->IsOp("+=")) {
-
-                llvm::Value* sum;
-                llvm::Value* leftVal;
-                
-                if (rhs->getType() == irgen->GetFloatType())  {
-       
-                    for(int i = 0; i < swLength; i++) {
-                        if(lSwizz[i] == 'x')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                        else if(lSwizz[i] == 'y')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                        else if(lSwizz[i] == 'z')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                        else
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
- 
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-
-                        leftVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);                    
-                        sum = llvm::BinaryOperator::CreateFAdd(leftVal,rhs,"",currBlk);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        value = llvm::InsertElementInst::Create(lhsLoc,sum,idx,"",currBlk);
-                        new llvm::StoreInst(value,sym->value,"",currBlk);
-                    }
-                } // FA += float
-                else {
-                    llvm::Value* rhsVal;
-                    llvm::Value* rhsIdx;
-              
-                    for(int i = 0; i < swLength; i++)  {
- 
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),i);
-                        rhsVal = llvm::ExtractElementInst::Create(rhs,rhsIdx,"",currBlk);
-
-                        if(lSwizz[i] == 'x')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                        else if(lSwizz[i] == 'y')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                        else if(lSwizz[i] == 'z')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                        else
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        
-                        leftVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);
-                        sum = llvm::BinaryOperator::CreateFAdd(leftVal,rhsVal,"",currBlk);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        value = llvm::InsertElementInst::Create(lhsLoc,sum,idx,"",currBlk);
-                        new llvm::StoreInst(value,sym->value,"",currBlk);
-                    }
-                } // FA += Vec
-            }//else if "+="
-
-            else if(op->IsOp("-="))  {
-
-                llvm::Value* diff;
-                llvm::Value* leftVal;
-                if(rhs->getType() == irgen -> GetFloatType()) {
-
-                    for(int i = 0; i < swLength; i++) {
-                        if(lSwizz[i] == 'x')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                        else if(lSwizz[i] == 'y')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                        else if(lSwizz[i] == 'z')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                        else
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
- 
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-
-                        leftVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);                    
-                        diff = llvm::BinaryOperator::CreateFSub(leftVal,rhs,"",currBlk);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        value = llvm::InsertElementInst::Create(lhsLoc,diff,idx,"",currBlk);
-                        new llvm::StoreInst(value,sym->value,"",currBlk);
-                    }
-                } // FA -= float
-                else {
-                    llvm::Value* rhsVal;
-                    llvm::Value* rhsIdx;
-              
-                    for(int i = 0; i < swLength; i++)  {
- 
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),i);
-                        rhsVal = llvm::ExtractElementInst::Create(rhs,rhsIdx,"",currBlk);
-
-                        if(lSwizz[i] == 'x')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                        else if(lSwizz[i] == 'y')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                        else if(lSwizz[i] == 'z')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                        else
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        
-                        leftVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);
-                        diff = llvm::BinaryOperator::CreateFSub(leftVal,rhsVal,"",currBlk);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        value = llvm::InsertElementInst::Create(lhsLoc,diff,idx,"",currBlk);
-                        new llvm::StoreInst(value,sym->value,"",currBlk);
-                    }
-                } //FA -= Vec
-            } // else if "-="
-            else if(op->IsOp("*="))  {
-
-                llvm::Value* prod;
-                llvm::Value* leftVal;
-
-                if(rhs->getType() == irgen -> GetFloatType()) {
-
-                    for(int i = 0; i < swLength; i++) {
-                        if(lSwizz[i] == 'x')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                        else if(lSwizz[i] == 'y')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                        else if(lSwizz[i] == 'z')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                        else
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
- 
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-
-                        leftVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);                    
-                        prod = llvm::BinaryOperator::CreateFMul(leftVal,rhs,"",currBlk);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        value = llvm::InsertElementInst::Create(lhsLoc,prod,idx,"",currBlk);
-                        new llvm::StoreInst(value,sym->value,"",currBlk);
-                    }
-                } // FA *= float
-                else {
-
-                    llvm::Value* rhsVal;
-                    llvm::Value* rhsIdx;
-              
-                    for(int i = 0; i < swLength; i++)  {
- 
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),i);
-                        rhsVal = llvm::ExtractElementInst::Create(rhs,rhsIdx,"",currBlk);
-
-                        if(lSwizz[i] == 'x')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                        else if(lSwizz[i] == 'y')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                        else if(lSwizz[i] == 'z')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                        else
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        
-                        leftVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);
-                        prod = llvm::BinaryOperator::CreateFMul(leftVal,rhsVal,"",currBlk);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        value = llvm::InsertElementInst::Create(lhsLoc,prod,idx,"",currBlk);
-                        new llvm::StoreInst(value,sym->value,"",currBlk);
-                    }
-                } //FA *= Vec
-            } // else if "*="
-             else if(op->IsOp("/="))  {
-
-                llvm::Value* quot;
-                llvm::Value* leftVal;
-
-                if(rhs->getType() == irgen -> GetFloatType()) {
-
-                    for(int i = 0; i < swLength; i++) {
-                        if(lSwizz[i] == 'x')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                        else if(lSwizz[i] == 'y')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                        else if(lSwizz[i] == 'z')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                        else
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
- 
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-
-                        leftVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);                    
-                        quot = llvm::BinaryOperator::CreateFDiv(leftVal,rhs,"",currBlk);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        value = llvm::InsertElementInst::Create(lhsLoc,quot,idx,"",currBlk);
-                        new llvm::StoreInst(value,sym->value,"",currBlk);
-                    }
-                } // FA /= float
-                else {
-
-                    llvm::Value* rhsVal;
-                    llvm::Value* rhsIdx;
-              
-                    for(int i = 0; i < swLength; i++)  {
- 
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),i);
-                        rhsVal = llvm::ExtractElementInst::Create(rhs,rhsIdx,"",currBlk);
-
-                        if(lSwizz[i] == 'x')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                        else if(lSwizz[i] == 'y')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                        else if(lSwizz[i] == 'z')
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                        else
-                            idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        
-                        leftVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);
-                        quot = llvm::BinaryOperator::CreateFDiv(leftVal,rhsVal,"",currBlk);
-
-                        lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                        value = llvm::InsertElementInst::Create(lhsLoc,quot,idx,"",currBlk);
-                        new llvm::StoreInst(value,sym->value,"",currBlk);
-                    }
-                } //FA /= Vec
-            } // else if "/="
-
 
-        
+        llvm::Value* vec = faL -> GetBase() -> Emit();
+        currBlk = irgen -> GetBasicBlock();
+        llvm::Value* vecLoc = LvalueAddress(symtab,faL->GetBase(),vec);
 
+        if(op->IsOp("="))
+            val = rhs;
+        else {
+            llvm::Value* lhs = irgen -> CreateSwizzle(vec,lSwizz,currBlk);
+            val = EmitCompoundOp(irgen,op,lhs,rhs,currBlk);
+        }
 
-                
-        } // FaR == null
-
-        // Right Side is a Field Access
-        else  if (faR != NULL){
-            
-            VarExpr* rAddr = dynamic_cast<VarExpr*>(faR->GetBase());
-            Rsym = symtab->findall(rAddr->GetIdentifier()->GetName());
-
-
-            if(op->IsOp("=")) {
-                                
-                llvm::Value* rhsVal;
-                llvm::Constant *rhsIdx;
-                //llvm::Value* leftAddr = sym -> value;
-                llvm::Value* rhsLoc = new llvm::LoadInst(Rsym->value,"",currBlk);
-
-                
-
-                for (int i = 0; i < swLength; i++)  {
-                    if(rSwizz[i] == 'x')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                    else if(rSwizz[i] == 'y')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                    else if(rSwizz[i] == 'z')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),2);  
-                    else
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),3);
- 
-                    rhsVal = llvm::ExtractElementInst::Create(rhsLoc,rhsIdx,"",currBlk);
-                    
-                    if(lSwizz[i] == 'x')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                    else if(lSwizz[i] == 'y')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                    else if(lSwizz[i] == 'z')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                    else
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                    lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                    value = llvm::InsertElementInst::Create(lhsLoc,rhsVal,idx,"",currBlk);
-                    new llvm::StoreInst(value,sym->value,"",currBlk);
-                }
-              
-            } // FA "=" FA
-
-            else if (op->IsOp("+="))  {
-                llvm::Value* rhsVal;
-                llvm::Value* lhsVal;
-                llvm::Constant *rhsIdx;
-                llvm::Value* sum;
-                llvm::Value* leftAddr = sym -> value;
-                llvm::Value* rhsLoc = new llvm::LoadInst(Rsym->value,"",currBlk);
-
-                bool swEqual = false;
-                int j;
-             
-                if(swLength == swizLen)
-                    swEqual = true;
-
-                for (int i = 0; i < swLength; i++)  {
- 
-                    if(swEqual == true)
-                        j = i;
-                    else
-                        j = 0;
-
-                    if(rSwizz[j] == 'x')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                    else if(rSwizz[j] == 'y')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                    else if(rSwizz[j] == 'z')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),2);  
-                    else
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                     
-                    rhsVal = llvm::ExtractElementInst::Create(rhsLoc,rhsIdx,"",currBlk);
-
-                    if(lSwizz[i] == 'x')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                    else if(lSwizz[i] == 'y')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                    else if(lSwizz[i] == 'z')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                    else
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                    lhsLoc = new llvm::LoadInst(leftAddr,"",currBlk);
-                    lhsVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);
-                    sum = llvm::BinaryOperator::CreateFAdd(lhsVal,rhsVal,"",currBlk);
-                    
-
-                    lhsLoc = new llvm::LoadInst(leftAddr,"",currBlk);
-                    value = llvm::InsertElementInst::Create(lhsLoc,sum,idx,"",currBlk);
-                    new llvm::StoreInst(value,leftAddr,"",currBlk);
-                }
-            } // FA += FA
-
-            else if (op->IsOp("-="))  {
-                llvm::Value* rhsVal;
-                llvm::Value* lhsVal;
-                llvm::Constant *rhsIdx;
-                llvm::Value* diff;
-                llvm::Value* leftAddr = sym -> value;
-                llvm::Value* rhsLoc = new llvm::LoadInst(Rsym->value,"",currBlk);
-
-                bool swEqual = false;
-                int j;
-             
-                if(swLength == swizLen)
-                    swEqual = true;
-
-                for (int i = 0; i < swLength; i++)  {
- 
-                    if(swEqual == true)
-                        j = i;
-                    else
-                        j = 0;
-
-                    if(rSwizz[j] == 'x')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                    else if(rSwizz[j] == 'y')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                    else if(rSwizz[j] == 'z')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),2);  
-                    else
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                     
-                    rhsVal = llvm::ExtractElementInst::Create(rhsLoc,rhsIdx,"",currBlk);
-
-                    if(lSwizz[i] == 'x')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                    else if(lSwizz[i] == 'y')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                    else if(lSwizz[i] == 'z')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                    else
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                    lhsLoc = new llvm::LoadInst(leftAddr,"",currBlk);
-                    lhsVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);
-                    diff = llvm::BinaryOperator::CreateFSub(lhsVal,rhsVal,"",currBlk);
-                    
-
-                    lhsLoc = new llvm::LoadInst(leftAddr,"",currBlk);
-                    value = llvm::InsertElementInst::Create(lhsLoc,diff,idx,"",currBlk);
-                    new llvm::StoreInst(value,leftAddr,"",currBlk);
-                }
-            } // FA -= FA
-
-            else if (op->IsOp("*="))  {
-                llvm::Value* rhsVal;
-                llvm::Value* lhsVal;
-                llvm::Constant *rhsIdx;
-                llvm::Value* prod;
-                llvm::Value* leftAddr = sym -> value;
-                llvm::Value* rhsLoc = new llvm::LoadInst(Rsym->value,"",currBlk);
-
-                bool swEqual = false;
-                int j;
-             
-                if(swLength == swizLen)
-                    swEqual = true;
-
-                for (int i = 0; i < swLength; i++)  {
- 
-                    if(swEqual == true)
-                        j = i;
-                    else
-                        j = 0;
-
-                    if(rSwizz[j] == 'x')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                    else if(rSwizz[j] == 'y')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                    else if(rSwizz[j] == 'z')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),2);  
-                    else
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                     
-                    rhsVal = llvm::ExtractElementInst::Create(rhsLoc,rhsIdx,"",currBlk);
-
-                    if(lSwizz[i] == 'x')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                    else if(lSwizz[i] == 'y')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                    else if(lSwizz[i] == 'z')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                    else
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                    lhsLoc = new llvm::LoadInst(leftAddr,"",currBlk);
-                    lhsVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);
-                    prod = llvm::BinaryOperator::CreateFMul(lhsVal,rhsVal,"",currBlk);
-                    
-
-                    lhsLoc = new llvm::LoadInst(leftAddr,"",currBlk);
-                    value = llvm::InsertElementInst::Create(lhsLoc,prod,idx,"",currBlk);
-                    new llvm::StoreInst(value,leftAddr,"",currBlk);
-                }
-            } // FA *= FA
-
-            else if (op->IsOp("/="))  {
-                llvm::Value* rhsVal;
-                llvm::Value* lhsVal;
-                llvm::Constant *rhsIdx;
-                llvm::Value* quot;
-                llvm::Value* leftAddr = sym -> value;
-                llvm::Value* rhsLoc = new llvm::LoadInst(Rsym->value,"",currBlk);
-
-                bool swEqual = false;
-                int j;
-             
-                if(swLength == swizLen)
-                    swEqual = true;
-
-                for (int i = 0; i < swLength; i++)  {
- 
-                    if(swEqual == true)
-                        j = i;
-                    else
-                        j = 0;
-
-                    if(rSwizz[j] == 'x')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                    else if(rSwizz[j] == 'y')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                    else if(rSwizz[j] == 'z')
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),2);  
-                    else
-                        rhsIdx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                     
-                    rhsVal = llvm::ExtractElementInst::Create(rhsLoc,rhsIdx,"",currBlk);
-
-                    if(lSwizz[i] == 'x')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                    else if(lSwizz[i] == 'y')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                    else if(lSwizz[i] == 'z')
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                    else
-                        idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                    lhsLoc = new llvm::LoadInst(leftAddr,"",currBlk);
-                    lhsVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);
-                    quot = llvm::BinaryOperator::CreateFDiv(lhsVal,rhsVal,"",currBlk);
-                    
-
-                    lhsLoc = new llvm::LoadInst(leftAddr,"",currBlk);
-                    value = llvm::InsertElementInst::Create(lhsLoc,quot,idx,"",currBlk);
-                    new llvm::StoreInst(value,leftAddr,"",currBlk);
-                }
-            } // FA /= FA
-        } // else 
-    } // else FAL != null
+        llvm::Value* res = irgen -> CreateSwizzleBlend(vec,val,lSwizz,currBlk);
+        irgen -> CreateStore(res,vecLoc,currBlk);
+    }
 
-    return rhs;
+    return val;
 }
 
 
 
 
 llvm::Value* PostfixExpr::Emit()  {
-    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
-    llvm::Value* lhs = left -> Emit();
-    llvm::LoadInst *lhsInst = llvm::cast<llvm::LoadInst>(lhs);
-    llvm::Value* lhsLoc = lhsInst->getPointerOperand();
-
     FieldAccess* faL = dynamic_cast<FieldAccess*>(left);
 
-    llvm::Value* inc = llvm::ConstantInt::get(irgen->GetIntType(),1);
-    llvm::Value* fInc = llvm::ConstantFP::get(irgen->GetFloatType(),1.0);
+    llvm::Value* lhs = NULL;
+    llvm::Value* vec = NULL;
+    llvm::Value* lhsLoc = NULL;
 
     //If Left is NOT A Field Access
     if(faL == NULL)  {
+        lhs = left -> Emit();
+        lhsLoc = LvalueAddress(symtab,left,lhs);
+    }
+    // Left is a Field Access
+    else  {
+        vec = faL -> GetBase() -> Emit();
+        lhsLoc = LvalueAddress(symtab,faL->GetBase(),vec);
+    }
 
-        if(op->IsOp("++"))  {
-
-            if(lhs->getType() == irgen->GetIntType()) {
-                llvm::Value* sum = llvm::BinaryOperator::CreateAdd(lhs,inc,"",currBlk);
- 
-                new llvm::StoreInst(sum,lhsLoc,"",currBlk);
-               
-            }
-            else if(lhs->getType() == irgen->GetFloatType()) {
-                llvm::Value* Fsum = llvm::BinaryOperator::CreateFAdd(lhs,fInc,"",currBlk);
-
-                new llvm::StoreInst(Fsum,lhsLoc,"",currBlk);
-            }
-            else {
-                int vecType = 0;
-
-                llvm::Value* vec = llvm::UndefValue::get(lhs->getType());
-
-                if(lhs->getType() == irgen->GetVec2Type())
-                    vecType = 2;
-                else if(lhs->getType() == irgen->GetVec3Type())
-                    vecType = 3;
-                else
-                    vecType = 4;
-            
-                for(int i = 0; i < vecType; i++) {
-                    llvm::Value* idx = llvm::ConstantInt::get(irgen->GetIntType(),i);
-
-                    vec = llvm::InsertElementInst::Create(vec,fInc,idx,"",currBlk);
-                    llvm::Value* Vsum = llvm::BinaryOperator::CreateFAdd(lhs,vec,"",currBlk);
-
-                    new llvm::StoreInst(Vsum,lhsLoc,"",currBlk);
-                }
-            }
-        }
-        else if (op->IsOp("--"))  {
-            
-            if(lhs->getType() == irgen->GetIntType()) {
-                llvm::Value* IDif = llvm::BinaryOperator::CreateSub(lhs,inc,"",currBlk);
-
-                new llvm::StoreInst(IDif,lhsLoc,currBlk);
-            }
-            else if(lhs->getType() == irgen->GetFloatType())  { 
-                llvm::Value* FDif = llvm::BinaryOperator::CreateFSub(lhs,fInc,"",currBlk);
-
-                new llvm::StoreInst(FDif,lhsLoc,"",currBlk);
-            }
-            else {
-                int vecType = 0;
-
-                llvm::Value* vec = llvm::UndefValue::get(lhs->getType());
+    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
 
-                if(lhs->getType() == irgen->GetVec2Type())
-                    vecType = 2;
-                else if(lhs->getType() == irgen->GetVec3Type())
-                    vecType = 3;
-                else
-                    vecType = 4;
-            
-                for(int i = 0; i < vecType; i++) {
-                    llvm::Value* idx = llvm::ConstantInt::get(irgen->GetIntType(),i);
+    if(faL != NULL)
+        lhs = irgen -> CreateSwizzle(vec,faL->GetField()->GetName(),currBlk);
 
-                    vec = llvm::InsertElementInst::Create(vec,fInc,idx,"",currBlk);
-                    llvm::Value* Vsum = llvm::BinaryOperator::CreateSub(lhs,vec,"",currBlk);
+    llvm::Value* val;
+    llvm::Value* one;
 
-                    new llvm::StoreInst(Vsum,lhsLoc,"",currBlk);
-                }
-            }
+    if(lhs->getType() == irgen->GetIntType())  {
+        one = llvm::ConstantInt::get(irgen->GetIntType(),1);
 
-        }
+        if(op->IsOp("++"))
+            val = irgen -> Builder().CreateAdd(lhs,one);
+        else
+            val = irgen -> Builder().CreateSub(lhs,one);
     }
-    // Left is a Field Access
     else  {
-        Symbol* sym;
-        llvm::Value* val;
-        llvm::Value* idx;
-
-        char* swizzle = faL -> GetField() -> GetName();
-        VarExpr* baseAddr = dynamic_cast<VarExpr*>(faL->GetBase());
-        sym = symtab->findall(baseAddr->GetIdentifier()->GetName());
-
-        for(int i = 0; i < strlen(swizzle); i++)  {
-            if(swizzle[i] == 'x')
-                    idx = llvm::ConstantInt::get(irgen->GetIntType(),0);
-                else if(swizzle[i] == 'y')
-                    idx = llvm::ConstantInt::get(irgen->GetIntType(),1);
-                else if(swizzle[i] == 'z')
-                    idx = llvm::ConstantInt::get(irgen->GetIntType(),2);
-                else
-                    idx = llvm::ConstantInt::get(irgen->GetIntType(),3);
-
-                lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                llvm::Value* lhsVal = llvm::ExtractElementInst::Create(lhsLoc,idx,"",currBlk);
-
-                if(op->IsOp("++"))
-                    val = llvm::BinaryOperator::CreateFAdd(lhsVal,fInc,"",currBlk);
-                else
-                    val = llvm::BinaryOperator::CreateFSub(lhsVal,fInc,"",currBlk);
-
-               
-                lhsLoc = new llvm::LoadInst(sym->value,"",currBlk);
-                llvm::Value* finVal = llvm::InsertElementInst::Create(lhsLoc,val,idx,"",currBlk);
-                new llvm::StoreInst(finVal,sym->value,"",currBlk);
-        }
-
+        one = llvm::ConstantFP::get(irgen->GetFloatType(),1.0);
+        if(lhs->getType() != irgen->GetFloatType())
+            one = irgen -> CreateSplat(one,lhs->getType(),currBlk);
 
+        if(op->IsOp("++"))
+            val = irgen -> Builder().CreateFAdd(lhs,one);
+        else
+            val = irgen -> Builder().CreateFSub(lhs,one);
     }
 
+    if(faL != NULL)
+        val = irgen -> CreateSwizzleBlend(vec,val,faL->GetField()->GetName(),currBlk);
+
+    irgen -> CreateStore(val,lhsLoc,currBlk);
+
     return lhs;
 }
 
@@ -1233,6 +665,75 @@ void ConditionalExpr::PrintChildren(int indentLevel) {
     trueExpr->Print(indentLevel+1, "(true) ");
     falseExpr->Print(indentLevel+1, "(false) ");
 }
+
+bool ConditionalExpr::HasSideEffects() {
+    return cond->HasSideEffects() || trueExpr->HasSideEffects() || falseExpr->HasSideEffects();
+}
+
+int ConditionalExpr::GetCost() {
+    return cond->GetCost() + trueExpr->GetCost() + falseExpr->GetCost() + 1;
+}
+
+
+// Both arms pure, unable to trap and no dearer than MaxSelectCost (as for
+// the right side of && and ||): evaluate both and pick one with a select,
+// which is branchless and works lane-wise for vector operands. Otherwise
+// only the chosen arm runs, so emit a diamond and a phi.
+llvm::Value* ConditionalExpr::Emit() {
+    llvm::LLVMContext* con = irgen -> GetContext();
+    llvm::Function* func = irgen -> GetFunction();
+
+    llvm::Value* test = cond -> Emit();
+
+    //Branchless Select
+    if(!trueExpr->HasSideEffects() && trueExpr->GetCost() <= MaxSelectCost &&
+       !falseExpr->HasSideEffects() && falseExpr->GetCost() <= MaxSelectCost)  {
+        llvm::Value* tVal = trueExpr -> Emit();
+        llvm::Value* fVal = falseExpr -> Emit();
+
+        return irgen -> Builder().CreateSelect(test,tVal,fVal);
+    }
+
+    //SPMD: each arm runs under the mask of the lanes that chose it
+    if(irgen->IsSPMD())  {
+        llvm::Value* mask = irgen -> GetMask();
+
+        irgen -> PushMask(irgen -> Builder().CreateAnd(mask,test));
+        llvm::Value* tVal = trueExpr -> Emit();
+        irgen -> PopMask();
+
+        llvm::Value* notTest = irgen -> Builder().CreateNot(test);
+        irgen -> PushMask(irgen -> Builder().CreateAnd(mask,notTest));
+        llvm::Value* fVal = falseExpr -> Emit();
+        irgen -> PopMask();
+
+        return irgen -> Builder().CreateSelect(test,tVal,fVal);
+    }
+
+    //Diamond
+    llvm::BasicBlock* trueBlk = llvm::BasicBlock::Create(*con,"CONDtrue",func);
+    llvm::BasicBlock* falseBlk = llvm::BasicBlock::Create(*con,"CONDfalse",func);
+    llvm::BasicBlock* footBlk = llvm::BasicBlock::Create(*con,"CONDfooter",func);
+
+    irgen -> Builder().CreateCondBr(test,trueBlk,falseBlk);
+
+    irgen -> SetBasicBlock(trueBlk);
+    llvm::Value* tVal = trueExpr -> Emit();
+    llvm::BasicBlock* trueEnd = irgen -> GetBasicBlock();
+    irgen -> Builder().CreateBr(footBlk);
+
+    irgen -> SetBasicBlock(falseBlk);
+    llvm::Value* fVal = falseExpr -> Emit();
+    llvm::BasicBlock* falseEnd = irgen -> GetBasicBlock();
+    irgen -> Builder().CreateBr(footBlk);
+
+    irgen -> SetBasicBlock(footBlk);
+    llvm::PHINode* res = irgen -> Builder().CreatePHI(tVal->getType(),2);
+    res -> addIncoming(tVal,trueEnd);
+    res -> addIncoming(fVal,falseEnd);
+
+    return res;
+}
 ArrayAccess::ArrayAccess(yyltype loc, Expr *b, Expr *s) : LValue(loc) {
     (base=b)->SetParent(this); 
     (subscript=s)->SetParent(this);
@@ -1242,31 +743,69 @@ void ArrayAccess::PrintChildren(int indentLevel) {
     base->Print(indentLevel+1);
     subscript->Print(indentLevel+1, "(subscript) ");
 }
+
+bool ArrayAccess::HasSideEffects() {
+    return base->HasSideEffects() || subscript->HasSideEffects();
+}
      
 
 
 
 
 
+// -fbounds-check. A constant index is checked here and needs no code. A
+// check on the induction variable of an enclosing for loop with a
+// constant range inside the array is handed to that loop, which removes
+// it if its body turns out not to assign the variable (see ForStmt::Emit).
+static void EmitBoundsCheck(IRGenerator* irgen, llvm::Value* idx, Symbol* sym) {
+    VarDecl* var = dynamic_cast<VarDecl*>(sym->decl);
+    ArrayType* arrayType = var ? dynamic_cast<ArrayType*>(var->GetType()) : NULL;
+    if(arrayType == NULL)
+        return;
+    int count = arrayType -> GetCount();
+
+    if(llvm::ConstantInt* c = llvm::dyn_cast<llvm::ConstantInt>(idx))  {
+        if(c->getSExtValue() < 0 || c->getSExtValue() >= count)
+            Failure("index %lld is out of bounds of %s[%d]", (long long) c->getSExtValue(),
+                    var->GetIdentifier()->GetName(), count);
+        return;
+    }
+
+    llvm::BranchInst* check = irgen -> CreateBoundsCheck(idx,count);
+
+    llvm::LoadInst* load = llvm::dyn_cast<llvm::LoadInst>(idx);
+    for(int i = (int) irgen->inductionVars.size() - 1; load != NULL && i >= 0; i--)  {
+        IRGenerator::InductionVar& iv = irgen -> inductionVars[i];
+        if(iv.slot == load->getPointerOperand())  {
+            if(iv.lo >= 0 && iv.hi < count)
+                iv.checks.push_back(check);
+            return;
+        }
+    }
+}
+
+
+
 llvm::Value* ArrayAccess::Emit() {
-    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
-   
     llvm::Value* idx = subscript -> Emit();
     llvm::Value* baseAddr = base -> Emit();
+    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
     
     VarExpr* baseVar = dynamic_cast<VarExpr*> (base);
     Symbol* sym = symtab->findall(baseVar -> GetIdentifier() -> GetName());
 
+    if(GetOptionForKey("bounds-check") != NULL && !irgen -> IsSPMD())
+        EmitBoundsCheck(irgen,idx,sym);
 
     vector<llvm::Value*> val;
-    val.push_back(llvm::ConstantInt::get(irgen->GetIntType(),0));
+    val.push_back(llvm::ConstantInt::get(irgen->GetIndexType(),0));
     val.push_back(idx);
     
 //    llvm::Value* baseLoc = new llvm::LoadInst(sym->value,"",currBlk);
 
 
-    llvm::Value* retVal = llvm::GetElementPtrInst::Create(sym->value,val,"",currBlk);
-    llvm::Value* ret =  new llvm::LoadInst(retVal,"",currBlk);
+    llvm::Value* retVal = irgen -> Builder().CreateGEP(sym->value,val);
+    llvm::Value* ret =  irgen -> Builder().CreateLoad(retVal);
     return ret;
 } 
 
@@ -1292,47 +831,25 @@ void FieldAccess::PrintChildren(int indentLevel) {
     field->Print(indentLevel+1);
 }
 
+bool FieldAccess::HasSideEffects() {
+    return base && base->HasSideEffects();
+}
 
+int FieldAccess::GetCost() {
+    return (base ? base->GetCost() : 0) + 1;
+}
 
 
 
 
-llvm::Value* FieldAccess::Emit() {
-    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
-    llvm::Value* baseAddr = base -> Emit();
-    llvm::Value* returnVal = NULL;
-
-    int swizzleLen = strlen(field->GetName());
-    string swizzle = field -> GetName();
-
-    vector<llvm::Constant*> idxMask;
-
-    //Get the Vector of indicies
-    for(int i = 0; i < swizzleLen; i++) {
-        if(swizzle[i] == 'x')
-            idxMask.push_back(llvm::ConstantInt::get(irgen->GetIntType(),0));
-        else if(swizzle[i] == 'y')
-            idxMask.push_back(llvm::ConstantInt::get(irgen->GetIntType(),1));
-        else if(swizzle[i] == 'z')
-            idxMask.push_back(llvm::ConstantInt::get(irgen->GetIntType(),2));
-        else if(swizzle[i] == 'w')
-            idxMask.push_back(llvm::ConstantInt::get(irgen->GetIntType(),3));
-    }
-    
-    //Handle if field length is 1
-    if(swizzleLen == 1) {
-        returnVal = llvm::ExtractElementInst::Create(baseAddr,idxMask[0],"",currBlk);
-    }
-    else { // Handle when field length is greater than 1.
-        
-        llvm::Value* mask = llvm::ConstantVector::get(idxMask);
-        returnVal = new llvm::ShuffleVectorInst(baseAddr,baseAddr,mask,"",currBlk);
-
-    }
 
 
+llvm::Value* FieldAccess::Emit() {
+    llvm::Value* baseAddr = base -> Emit();
+    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
 
-    return returnVal;
+    // One extractelement for a single lane, one shufflevector otherwise
+    return irgen -> CreateSwizzle(baseAddr,field->GetName(),currBlk);
 }
 
 
@@ -1363,7 +880,6 @@ void Call::PrintChildren(int indentLevel) {
 
 
 llvm::Value* Call::Emit()  {
-    llvm::BasicBlock* curBlk = irgen -> GetBasicBlock();
     vector<llvm::Value*> param;
     llvm::Value* retVal;
     Symbol* sym = symtab->findall(field -> GetName());
@@ -1376,7 +892,14 @@ llvm::Value* Call::Emit()  {
 
     }
 
-    retVal = llvm::CallInst::Create(func,param,"",curBlk);
+    // SPMD functions take the caller's execution mask as a hidden first argument
+    if(irgen->IsSPMD())
+        param.insert(param.begin(),irgen->GetMask());
+
+    retVal = irgen -> Builder().CreateCall(func,param);
+
+    //The callee may write any global
+    irgen -> InvalidateLoads(NULL);
     
     return retVal;
 }
@@ -31,6 +31,14 @@ class Expr : public Stmt
     }
     
     virtual llvm::Value* Emit() { return NULL; }
+
+    // Used to decide whether an expression may be evaluated unconditionally
+    // (branchless) instead of behind a branch. GetCost() estimates the
+    // number of instructions and is NotSpeculatable if evaluation may trap.
+    static const int MaxSelectCost = 4;
+    static const int NotSpeculatable = 1000;
+    virtual bool HasSideEffects() { return true; }
+    virtual int GetCost() { return NotSpeculatable; }
 };
 
 class ExprError : public Expr
@@ -47,6 +55,8 @@ class EmptyExpr : public Expr
 {
   public:
     const char *GetPrintNameForNode() { return "Empty"; }
+    bool HasSideEffects() { return false; }
+    int GetCost() { return 0; }
 };
 
 class IntConstant : public Expr 
@@ -58,6 +68,9 @@ class IntConstant : public Expr
     IntConstant(yyltype loc, int val);
     const char *GetPrintNameForNode() { return "IntConstant"; }
     void PrintChildren(int indentLevel);
+    int GetValue() { return value; }
+    bool HasSideEffects() { return false; }
+    int GetCost() { return 0; }
 
     virtual llvm::Value* Emit();
 };
@@ -71,6 +84,8 @@ class FloatConstant: public Expr
     FloatConstant(yyltype loc, double val);
     const char *GetPrintNameForNode() { return "FloatConstant"; }
     void PrintChildren(int indentLevel);
+    bool HasSideEffects() { return false; }
+    int GetCost() { return 0; }
 
     virtual llvm::Value* Emit();
 };
@@ -84,6 +99,8 @@ class BoolConstant : public Expr
     BoolConstant(yyltype loc, bool val);
     const char *GetPrintNameForNode() { return "BoolConstant"; }
     void PrintChildren(int indentLevel);
+    bool HasSideEffects() { return false; }
+    int GetCost() { return 0; }
 
     virtual llvm::Value* Emit();
 };
@@ -98,6 +115,8 @@ class VarExpr : public Expr
     const char *GetPrintNameForNode() { return "VarExpr"; }
     void PrintChildren(int indentLevel);
     Identifier *GetIdentifier() {return id;}
+    bool HasSideEffects() { return false; }
+    int GetCost() { return 1; }
 
     virtual llvm::Value* Emit();
   
@@ -127,6 +146,11 @@ class CompoundExpr : public Expr
     CompoundExpr(Operator *op, Expr *rhs);             // for unary
     CompoundExpr(Expr *lhs, Operator *op);             // for unary
     void PrintChildren(int indentLevel);
+    Operator *GetOp() { return op; }
+    Expr *GetLeft() { return left; }
+    Expr *GetRight() { return right; }
+    bool HasSideEffects();
+    int GetCost();
 
     virtual llvm::Value* Emit() {return NULL;}
 };
@@ -137,6 +161,8 @@ class ArithmeticExpr : public CompoundExpr
     ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
     const char *GetPrintNameForNode() { return "ArithmeticExpr"; }
+    bool HasSideEffects();
+    int GetCost();
 
     virtual llvm::Value* Emit();
 };
@@ -174,6 +200,7 @@ class AssignExpr : public CompoundExpr
   public:
     AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "AssignExpr"; }
+    bool HasSideEffects() { return true; }
 
     virtual llvm::Value* Emit();
 };
@@ -183,6 +210,7 @@ class PostfixExpr : public CompoundExpr
   public:
     PostfixExpr(Expr *lhs, Operator *op) : CompoundExpr(lhs,op) {}
     const char *GetPrintNameForNode() { return "PostfixExpr"; }
+    bool HasSideEffects() { return true; }
 
     virtual llvm::Value* Emit();
 
@@ -196,6 +224,10 @@ class ConditionalExpr : public Expr
     ConditionalExpr(Expr *c, Expr *t, Expr *f);
     void PrintChildren(int indentLevel);
     const char *GetPrintNameForNode() { return "ConditionalExpr"; }
+    bool HasSideEffects();
+    int GetCost();
+
+    virtual llvm::Value* Emit();
 };
 
 class LValue : public Expr 
@@ -215,6 +247,7 @@ class ArrayAccess : public LValue
     ArrayAccess(yyltype loc, Expr *base, Expr *subscript);
     const char *GetPrintNameForNode() { return "ArrayAccess"; }
     void PrintChildren(int indentLevel);
+    bool HasSideEffects();
 
     virtual llvm::Value* Emit();
 };
@@ -234,6 +267,8 @@ class FieldAccess : public LValue
     FieldAccess(Expr *base, Identifier *field); //ok to pass NULL base
     const char *GetPrintNameForNode() { return "FieldAccess"; }
     void PrintChildren(int indentLevel);
+    bool HasSideEffects();
+    int GetCost();
     Identifier *GetField() { return field; } 
     Expr *GetBase() { return base; }
 
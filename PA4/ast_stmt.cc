@@ -2,6 +2,8 @@
  * -----------------
  * Implementation of statement node classes.
  */
+#include <string.h>
+#include <algorithm>
 #include "ast_stmt.h"
 #include "ast_type.h"
 #include "ast_decl.h"
@@ -9,7 +11,17 @@
 #include "symtable.h"
 
 #include "irgen.h"
+#include "jit.h"
+#include "codegen.h"
+#include "timer.h"
+#include "stats.h"
+#include "profile.h"
+#include "executor.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Host.h"
 #include "llvm/Support/raw_ostream.h"                                                   
 
 
@@ -31,17 +43,112 @@ llvm::Value* Program::Emit() {
     // for individual node to fill in the module structure and instructions.
     
     
+    // -spmd=N: every function runs N invocations at once
+    if ( GetOptionForKey("spmd") != NULL )
+        irgen->SetLaneCount(atoi(GetOptionForKey("spmd")));
+
+    // -march: target the host (or the named CPU) instead of generic x86-64
+    if ( GetOptionForKey("march") != NULL )
+        irgen->SetTargetMachine(CreateTargetMachine(llvm::sys::getProcessTriple()));
+
     llvm::Module *mod = irgen->GetOrCreateModule("test.bc");
 
+    // -j<N>: functions are emitted on N threads
+    int jobs = 0;
+    if ( GetOptionForKey("jobs") != NULL )
+        jobs = atoi(GetOptionForKey("jobs"));
 
-    for(int i = 0; i < decls->NumElements(); i++)  {
-        Decl* decl = decls->Nth(i);
-        decl -> Emit();
+    if ( jobs > 0 ) {
+        StartPhase("irgen");
+        EmitParallel(jobs);
+        symtab -> pop();
+        EndPhase();
+
+        // helpers are internalized and inlined across the linked modules
+        StartPhase("inline");
+        irgen->InternalizeHelpers();
+        irgen->InlineFunctions(GetOptLevel());
+        EndPhase();
+
+        // -fprofile-generate: the exported routine that writes the counters
+        if ( GetOptionForKey("profile-generate") != NULL )
+            EmitProfileWriter(mod);
+
+        // readnone/readonly on functions and calls, for CSE and LICM
+        StartPhase("purity");
+        irgen->InferMemoryEffects();
+        EndPhase();
+
+        // the same pipeline, in the same order, as without -j
+        StartPhase("optimize");
+        irgen->Optimize(GetOptLevel());
+        EndPhase();
+    }
+    else {
+        StartPhase("irgen");
+        for(int i = 0; i < decls->NumElements(); i++)  {
+            Decl* decl = decls->Nth(i);
+            decl -> Emit();
+        }
+        symtab -> pop();
+        irgen->FinalizeDebugInfo();
+
+        // host entry points that loop over arrays of invocations
+        if ( irgen->IsSPMD() ) {
+            vector<llvm::Function*> funcs;
+            for ( llvm::Module::iterator f = mod->begin(); f != mod->end(); f++ )
+                if ( !f->isDeclaration() )
+                    funcs.push_back(&*f);
+
+            for ( size_t i = 0; i < funcs.size(); i++ )
+                irgen->CreateSPMDKernel(funcs[i]);
+        }
+        EndPhase();
+
+        // promote the entry block allocas to registers
+        StartPhase("mem2reg");
+        irgen->PromoteToRegisters();
+        EndPhase();
+
+        // internal helpers, small calls inlined
+        StartPhase("inline");
+        irgen->InternalizeHelpers();
+        irgen->InlineFunctions(GetOptLevel());
+        EndPhase();
+
+        // -fprofile-generate: the exported routine that writes the counters
+        if ( GetOptionForKey("profile-generate") != NULL )
+            EmitProfileWriter(mod);
+
+        // readnone/readonly on functions and calls, for CSE and LICM
+        StartPhase("purity");
+        irgen->InferMemoryEffects();
+        EndPhase();
+
+        // run the pass pipeline selected with -O<level>
+        StartPhase("optimize");
+        irgen->Optimize(GetOptLevel());
+        EndPhase();
+    }
+
+    // --stats=json: per-function block and instruction counts
+    if ( GetOptionForKey("stats") != NULL )
+        PrintModuleStats(mod);
+
+    // run the program in-process for --run, no bitcode is written
+    if ( GetOptionForKey("run") != NULL ) {
+        PhaseTimer timer("run");
+        if ( GetOptionForKey("bench") != NULL )
+            RunShaderBatch(mod, GetOptionForKey("run"), atoi(GetOptionForKey("bench")));
+        else
+            RunShader(mod, GetOptionForKey("run"));
+        return NULL;
     }
-    symtab -> pop();
     
-    // write the BC into standard output 
-    llvm::WriteBitcodeToFile(mod, llvm::outs());
+    // write bitcode, IR, assembly or an object file (-emit, -o)
+    StartPhase("output");
+    WriteModule(mod);
+    EndPhase();
 
     //uncomment the next line to generate the human readable/assembly file
     //mod->dump();
@@ -50,6 +157,136 @@ llvm::Value* Program::Emit() {
     return NULL;
 }
 
+// Shared by the threads of the parallel code generator
+struct ParallelEmit {
+    Program *program;
+    IRGenerator *mainIrgen;         // the main thread's generator
+    int laneCount;                  // -spmd, as set on mainIrgen
+    DeclMap globals;                // every top-level decl, by name
+    vector<int> funcs;              // index of each FnDecl in decls
+    vector<std::string> bitcode;    // the module of funcs[k], as bitcode
+};
+
+static void EmitFunctionChunk(void *data, int begin, int end) {
+    ParallelEmit *work = (ParallelEmit*) data;
+    for ( int k = begin; k < end; k++ )
+        work->program->EmitFunctionModule(work, k);
+}
+
+// Every FnDecl is emitted and promoted to registers in an LLVMContext and
+// module of its own, on jobs threads. The globals are defined in the main
+// module, which then links in the function modules in source order, so
+// the output is the same for any number of threads. Inlining and the pass
+// pipeline run on the linked module, in the order Program::Emit uses
+// without -j, and its -g subprograms are moved to the main compile unit.
+void Program::EmitParallel(int jobs) {
+    llvm::Module *mod = irgen->GetOrCreateModule("test.bc");
+
+    // The workers' thread_local generators are not the main thread's, so
+    // what Program::Emit set on irgen is handed to them here
+    ParallelEmit work;
+    work.program = this;
+    work.mainIrgen = irgen;
+    work.laneCount = irgen->GetLaneCount();
+
+    for(int i = 0; i < decls->NumElements(); i++)  {
+        Decl* decl = decls->Nth(i);
+        work.globals[decl->GetIdentifier()->GetName()] = decl;
+
+        if ( dynamic_cast<FnDecl*>(decl) != NULL )
+            work.funcs.push_back(i);
+        else
+            decl -> Emit();
+    }
+    irgen->FinalizeDebugInfo();
+    work.bitcode.resize(work.funcs.size());
+
+    Executor executor(jobs);
+    executor.Run(work.funcs.size(), 1, EmitFunctionChunk, &work);
+
+    for ( size_t k = 0; k < work.funcs.size(); k++ ) {
+        const char *name = decls->Nth(work.funcs[k])->GetIdentifier()->GetName();
+
+        llvm::ErrorOr<std::unique_ptr<llvm::Module> > part =
+            llvm::parseBitcodeFile(llvm::MemoryBufferRef(work.bitcode[k], name),
+                                   *irgen->GetContext());
+        if ( !part )
+            Failure("Cannot read back the module of %s: %s", name,
+                    part.getError().message().c_str());
+
+        if ( llvm::Linker::linkModules(*mod, std::move(part.get())) )
+            Failure("Cannot link the module of %s", name);
+    }
+    irgen->MergeCompileUnits();
+}
+
+// Runs on a worker thread. The thread's generator and symbol table are
+// swapped for fresh ones, so the function is emitted into a new module;
+// the globals and functions it refers to are declared there on first use
+// (see SymbolTable::setExternals) and resolved when the modules are linked.
+// A spawned thread's own generator, symbol table and stack are unused and
+// freed on its first function; the main thread gets its own back.
+void Program::EmitFunctionModule(ParallelEmit *work, int k) {
+    FnDecl *fn = dynamic_cast<FnDecl*>(decls->Nth(work->funcs[k]));
+
+    IRGenerator *threadIrgen = irgen;
+    SymbolTable *threadSymtab = symtab;
+    MyStack *threadStack = mystack;
+    bool mainThread = (threadIrgen == work->mainIrgen);
+
+    irgen = new IRGenerator;
+    symtab = new SymbolTable;
+    mystack = new MyStack;
+    symtab->setExternals(&work->globals);
+
+    irgen->SetLaneCount(work->laneCount);
+    if ( GetOptionForKey("march") != NULL ) {
+        static thread_local llvm::TargetMachine *tm =
+            CreateTargetMachine(llvm::sys::getProcessTriple());
+        irgen->SetTargetMachine(tm);
+    }
+    llvm::Module *mod = irgen->GetOrCreateModule(fn->GetIdentifier()->GetName());
+
+    llvm::Function *func = llvm::cast<llvm::Function>(fn->Emit());
+    irgen->FinalizeDebugInfo();
+    if ( irgen->IsSPMD() )
+        irgen->CreateSPMDKernel(func);
+    irgen->PromoteToRegisters();
+
+    // Const globals were folded into their uses; the copies declared here
+    // are left over
+    for ( llvm::Module::global_iterator g = mod->global_begin(); g != mod->global_end(); ) {
+        llvm::GlobalVariable *gv = &*g++;
+        if ( gv->hasLocalLinkage() && gv->use_empty() )
+            gv->eraseFromParent();
+    }
+
+    llvm::raw_string_ostream os(work->bitcode[k]);
+    llvm::WriteBitcodeToFile(mod, os);
+    os.flush();
+
+    llvm::LLVMContext *context = irgen->GetContext();
+    delete mod;
+    delete context;
+    delete irgen;
+    delete symtab;
+    delete mystack;
+
+    if ( mainThread ) {
+        irgen = threadIrgen;
+        symtab = threadSymtab;
+        mystack = threadStack;
+    }
+    else {
+        delete threadIrgen;
+        delete threadSymtab;
+        delete threadStack;
+        irgen = NULL;
+        symtab = NULL;
+        mystack = NULL;
+    }
+}
+
 StmtBlock::StmtBlock(List<VarDecl*> *d, List<Stmt*> *s) {
     Assert(d != NULL && s != NULL);
     (decls=d)->SetParentAll(this);
@@ -69,6 +306,7 @@ llvm::Value* StmtBlock::Emit() {
     //Emit Each VarDecl
     for(int i = 0; i < decls->NumElements(); i++)  {
         VarDecl* vdecl = decls->Nth(i);
+        vdecl -> EmitDebugLocation();
         vdecl -> Emit();
     }
 
@@ -76,6 +314,7 @@ llvm::Value* StmtBlock::Emit() {
     for(int i = 0; i < stmts->NumElements(); i++)  {
 
         Stmt* stmt = stmts->Nth(i);
+        stmt -> EmitDebugLocation();
 
         expr = dynamic_cast<Expr*>(stmt);
         if(expr == NULL)        
@@ -139,7 +378,80 @@ void ForStmt::PrintChildren(int indentLevel) {
 }
 
 
+// -fbounds-check: recognizes "i = c0; i < n (or i <= n); i += c", with i++,
+// ++i or i = i + c also accepted as the step, for constants c0 >= 0 and
+// c > 0. Unless the body assigns it, i stays within [c0, n-1] there.
+static bool IsVar(Expr *e, const char *name) {
+    VarExpr* var = dynamic_cast<VarExpr*>(e);
+    return var != NULL && strcmp(var->GetIdentifier()->GetName(), name) == 0;
+}
+
+static bool IsPositive(Expr *e) {
+    IntConstant* c = dynamic_cast<IntConstant*>(e);
+    return c != NULL && c->GetValue() > 0;
+}
+
+static bool IsIncrement(Expr *step, const char *name) {
+    CompoundExpr* expr = dynamic_cast<CompoundExpr*>(step);
+    if(expr == NULL)
+        return false;
+
+    Operator* op = expr -> GetOp();
+    if(dynamic_cast<PostfixExpr*>(expr))
+        return op->IsOp("++") && IsVar(expr->GetLeft(),name);
+    if(dynamic_cast<ArithmeticExpr*>(expr))
+        return expr->GetLeft() == NULL && op->IsOp("++") && IsVar(expr->GetRight(),name);
+    if(dynamic_cast<AssignExpr*>(expr) == NULL || !IsVar(expr->GetLeft(),name))
+        return false;
+
+    if(op->IsOp("+="))
+        return IsPositive(expr->GetRight());
+    ArithmeticExpr* sum = dynamic_cast<ArithmeticExpr*>(expr->GetRight());
+    return op->IsOp("=") && sum != NULL && sum->GetOp()->IsOp("+") &&
+           IsVar(sum->GetLeft(),name) && IsPositive(sum->GetRight());
+}
+
+static const char* GetInductionRange(Expr *init, Expr *test, Expr *step, int &lo, int &hi) {
+    AssignExpr* assign = dynamic_cast<AssignExpr*>(init);
+    if(assign == NULL || !assign->GetOp()->IsOp("="))
+        return NULL;
+
+    VarExpr* var = dynamic_cast<VarExpr*>(assign->GetLeft());
+    IntConstant* start = dynamic_cast<IntConstant*>(assign->GetRight());
+    RelationalExpr* cmp = dynamic_cast<RelationalExpr*>(test);
+    if(var == NULL || start == NULL || cmp == NULL)
+        return NULL;
+
+    const char* name = var -> GetIdentifier() -> GetName();
+    IntConstant* bound = dynamic_cast<IntConstant*>(cmp->GetRight());
+    if(!IsVar(cmp->GetLeft(),name) || bound == NULL || !IsIncrement(step,name))
+        return NULL;
+
+    if(cmp->GetOp()->IsOp("<"))
+        hi = bound->GetValue() - 1;
+    else if(cmp->GetOp()->IsOp("<="))
+        hi = bound->GetValue();
+    else
+        return NULL;
+
+    lo = start -> GetValue();
+    return name;
+}
+
+static int CountStores(llvm::Value *slot) {
+    int n = 0;
+    for(llvm::Value::user_iterator u = slot->user_begin(); u != slot->user_end(); u++)
+        if(llvm::isa<llvm::StoreInst>(*u))
+            n++;
+    return n;
+}
+
+
+
 llvm::Value* ForStmt::Emit() {
+    if(irgen -> IsSPMD())
+        return EmitSPMD(init,step);
+
     llvm::Function* func = irgen -> GetFunction();
     llvm::LLVMContext* con = irgen -> GetContext();
     llvm::BasicBlock *stepBlk = NULL;
@@ -163,23 +475,32 @@ llvm::Value* ForStmt::Emit() {
     llvm::BasicBlock* headBlk = llvm::BasicBlock::Create(*con,"FORhead",func);
     // irgen -> footStack -> push(headBlk);
 
+    irgen -> CountBlock(headBlk);
+    irgen -> CountBlock(bodyBlk);
+    irgen -> CountBlock(stepBlk);
+    irgen -> CountBlock(footBlk);
+
 
     //Emit Init
-    if(init != NULL)
+    if(init != NULL)  {
+        init -> EmitDebugLocation();
         init -> Emit();
+    }
 
 
     //Create Branch to Terminate Current Block
-    llvm::BranchInst::Create(headBlk,currBlk);
+    llvm::BasicBlock* entryBlk = irgen -> GetBasicBlock();
+    llvm::BranchInst::Create(headBlk,entryBlk);
 
 
     //IrGen for Head Block + Emit for Test
     irgen -> SetBasicBlock(headBlk);
+    test -> EmitDebugLocation();
     llvm::Value* val = test -> Emit();
 
     
-    //Jump to Footer
-    llvm::BranchInst::Create(bodyBlk,footBlk,val,headBlk);
+    //Jump to Footer (the test may have ended in a block other than headBlk)
+    llvm::BranchInst::Create(bodyBlk,footBlk,val,irgen->GetBasicBlock());
 
 
     symtab->push();
@@ -187,23 +508,50 @@ llvm::Value* ForStmt::Emit() {
     irgen -> SetBasicBlock(bodyBlk);
     irgen -> brkStack -> push(footBlk);
     irgen -> contStack -> push(stepBlk);
+
+    int lo = 0, hi = -1, stores = 0;
+    const char* ivName = NULL;
+    if(GetOptionForKey("bounds-check") != NULL)
+        ivName = GetInductionRange(init,test,step,lo,hi);
+    Symbol* ivSym = ivName ? symtab -> findall(ivName) : NULL;
+    bool tracked = (ivSym != NULL && llvm::isa<llvm::AllocaInst>(ivSym->value));
+    if(tracked)  {
+        IRGenerator::InductionVar iv;
+        iv.slot = ivSym -> value;
+        iv.lo = lo;
+        iv.hi = hi;
+        irgen -> inductionVars.push_back(iv);
+        stores = CountStores(iv.slot);
+    }
+
+    body -> EmitDebugLocation();
     body -> Emit();
 
+    //The checks on an induction variable the body never assigns are redundant
+    if(tracked)  {
+        IRGenerator::InductionVar iv = irgen -> inductionVars.back();
+        irgen -> inductionVars.pop_back();
+        if(CountStores(iv.slot) == stores)
+            for(size_t i = 0; i < iv.checks.size(); i++)
+                irgen -> RemoveBoundsCheck(iv.checks[i]);
+    }
+
 
  
-    // Check for Terminator Inst
+    // Check for Terminator Inst (the body may have ended in another block)
     llvm::BasicBlock* checkBlk = irgen -> GetBasicBlock();
-    if(bodyBlk -> getTerminator() == NULL)
-        llvm::BranchInst::Create(stepBlk,bodyBlk);
+    if(checkBlk -> getTerminator() == NULL)
+        llvm::BranchInst::Create(stepBlk,checkBlk);
     symtab -> pop();
 
    
     //Emit for Step
     irgen -> SetBasicBlock(stepBlk);
+    step -> EmitDebugLocation();
     step -> Emit();
 
     // Create Terminator for Step
-    llvm::BranchInst::Create(headBlk,stepBlk);
+    llvm::BranchInst::Create(headBlk,irgen->GetBasicBlock());
 
 
 
@@ -216,6 +564,8 @@ llvm::Value* ForStmt::Emit() {
 
 
 
+    AttachLoopHints(headBlk,entryBlk);
+
     //irgen -> footStack -> pop();
     irgen -> brkStack -> pop();
     irgen -> contStack -> pop();
@@ -228,6 +578,126 @@ llvm::Value* ForStmt::Emit() {
 
 
 
+// Loop hints become the loop's llvm.loop node, which LoopUnroll and
+// LoopVectorize read from the terminator of every latch: here each block
+// branching back to headBlk other than entryBlk, the one entering the loop.
+void LoopStmt::AttachLoopHints(llvm::BasicBlock *headBlk, llvm::BasicBlock *entryBlk) {
+    if(unroll == 0 && vectorize == 0)
+        return;
+
+    llvm::LLVMContext* con = irgen -> GetContext();
+    IRGenerator::FoldingBuilder& builder = irgen -> Builder();
+
+    // The first operand refers to the node itself, keeping it distinct
+    llvm::TempMDTuple self = llvm::MDNode::getTemporary(*con, llvm::None);
+    vector<llvm::Metadata*> hints;
+    hints.push_back(self.get());
+
+    if(unroll == 1)
+        hints.push_back(llvm::MDNode::get(*con, llvm::MDString::get(*con,"llvm.loop.unroll.disable")));
+    else if(unroll > 1) {
+        llvm::Metadata* count[] = { llvm::MDString::get(*con,"llvm.loop.unroll.count"),
+                                    llvm::ConstantAsMetadata::get(builder.getInt32(unroll)) };
+        hints.push_back(llvm::MDNode::get(*con, count));
+    }
+
+    if(vectorize > 0) {
+        llvm::Metadata* width[] = { llvm::MDString::get(*con,"llvm.loop.vectorize.width"),
+                                    llvm::ConstantAsMetadata::get(builder.getInt32(vectorize)) };
+        llvm::Metadata* enable[] = { llvm::MDString::get(*con,"llvm.loop.vectorize.enable"),
+                                     llvm::ConstantAsMetadata::get(builder.getInt1(vectorize > 1)) };
+        hints.push_back(llvm::MDNode::get(*con, width));
+        hints.push_back(llvm::MDNode::get(*con, enable));
+    }
+
+    llvm::MDNode* loopID = llvm::MDNode::get(*con, hints);
+    loopID -> replaceOperandWith(0, loopID);
+
+    for(llvm::pred_iterator p = llvm::pred_begin(headBlk); p != llvm::pred_end(headBlk); p++)
+        if(*p != entryBlk)
+            (*p) -> getTerminator() -> setMetadata(llvm::LLVMContext::MD_loop, loopID);
+}
+
+
+
+
+
+// SPMD loop: keeps iterating while any lane is still in the loop. A lane
+// whose test fails, or that breaks, is cleared from the loop's kill slot;
+// a continue clears it from the per-iteration slot only, so it comes back
+// for the step and the next test.
+llvm::Value* LoopStmt::EmitSPMD(Expr *init, Expr *step) {
+    llvm::Function* func = irgen -> GetFunction();
+    llvm::LLVMContext* con = irgen -> GetContext();
+
+    llvm::BasicBlock* headBlk = llvm::BasicBlock::Create(*con,"LOOPhead",func);
+    llvm::BasicBlock* bodyBlk = llvm::BasicBlock::Create(*con,"LOOPbody",func);
+    llvm::BasicBlock* footBlk = llvm::BasicBlock::Create(*con,"LOOPfooter",func);
+
+    llvm::Value* loopSlot = irgen -> CreateEntryBlockAlloca(irgen->GetBoolType(),"loopmask");
+    llvm::Value* contSlot = irgen -> CreateEntryBlockAlloca(irgen->GetBoolType(),"contmask");
+
+    //Emit Init
+    if(init != NULL)  {
+        init -> EmitDebugLocation();
+        init -> Emit();
+    }
+
+    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
+    llvm::BasicBlock* entryBlk = currBlk;
+    new llvm::StoreInst(irgen->GetMask(),loopSlot,currBlk);
+    llvm::BranchInst::Create(headBlk,currBlk);
+    irgen -> PushKillSlot(loopSlot);
+
+
+    //Emit Test, lanes where it is false leave the loop
+    irgen -> SetBasicBlock(headBlk);
+    test -> EmitDebugLocation();
+    llvm::Value* val = test -> Emit();
+    currBlk = irgen -> GetBasicBlock();
+
+    llvm::Value* live = new llvm::LoadInst(loopSlot,"",currBlk);
+    live = llvm::BinaryOperator::CreateAnd(live,val,"",currBlk);
+    new llvm::StoreInst(live,loopSlot,currBlk);
+
+    llvm::Value* any = irgen -> AnyLane(irgen->GetMask(),currBlk);
+    llvm::BranchInst::Create(bodyBlk,footBlk,any,currBlk);
+
+
+    //Emit Body
+    symtab -> push();
+    irgen -> SetBasicBlock(bodyBlk);
+    new llvm::StoreInst(irgen->GetMask(),contSlot,bodyBlk);
+    irgen -> PushKillSlot(contSlot);
+    irgen -> brkMaskStack.push_back(loopSlot);
+    irgen -> contMaskStack.push_back(contSlot);
+
+    body -> EmitDebugLocation();
+    body -> Emit();
+
+    irgen -> contMaskStack.pop_back();
+    irgen -> brkMaskStack.pop_back();
+    irgen -> PopKillSlot();
+    symtab -> pop();
+
+
+    //Emit Step
+    if(step != NULL)  {
+        step -> EmitDebugLocation();
+        step -> Emit();
+    }
+    llvm::BranchInst::Create(headBlk,irgen->GetBasicBlock());
+    AttachLoopHints(headBlk,entryBlk);
+
+    irgen -> PopKillSlot();
+    irgen -> SetBasicBlock(footBlk);
+
+    return NULL;
+}
+
+
+
+
 void WhileStmt::PrintChildren(int indentLevel) {
     test->Print(indentLevel+1, "(test) ");
     body->Print(indentLevel+1, "(body) ");
@@ -235,6 +705,9 @@ void WhileStmt::PrintChildren(int indentLevel) {
 
 
 llvm::Value* WhileStmt::Emit()  {
+    if(irgen -> IsSPMD())
+        return EmitSPMD(NULL,NULL);
+
     llvm::LLVMContext* con = irgen->GetContext();
     llvm::Function* func = irgen->GetFunction();
 
@@ -242,6 +715,9 @@ llvm::Value* WhileStmt::Emit()  {
     llvm::BasicBlock* headBlk = llvm::BasicBlock::Create(*con,"Whhead",func);
     llvm::BasicBlock* bodyBlk = llvm::BasicBlock::Create(*con,"Whbody",func);
     llvm::BasicBlock* footBlk = llvm::BasicBlock::Create(*con,"WHfooter",func);
+    irgen -> CountBlock(headBlk);
+    irgen -> CountBlock(bodyBlk);
+    irgen -> CountBlock(footBlk);
 
     irgen -> footStack -> push(footBlk);
     irgen -> brkStack -> push(footBlk);
@@ -253,21 +729,23 @@ llvm::Value* WhileStmt::Emit()  {
 
     //Emit Value into Header
     irgen -> SetBasicBlock(headBlk);
+    test -> EmitDebugLocation();
     llvm::Value* val = test -> Emit();
     
 
     //Create Branch Instruction to decide between body or footer
-    llvm::BranchInst::Create(bodyBlk,footBlk,val,headBlk);
+    llvm::BranchInst::Create(bodyBlk,footBlk,val,irgen->GetBasicBlock());
 
     
     // Emit Body Code in Body Block
     symtab -> push();
 
     irgen -> SetBasicBlock(bodyBlk);
+    body -> EmitDebugLocation();
     body -> Emit();
 
-    if(bodyBlk -> getTerminator() == NULL)
-        llvm::BranchInst::Create(headBlk,bodyBlk);
+    if(irgen -> GetBasicBlock() -> getTerminator() == NULL)
+        llvm::BranchInst::Create(headBlk,irgen -> GetBasicBlock());
     
 
     // Check for nested
@@ -279,6 +757,7 @@ llvm::Value* WhileStmt::Emit()  {
     }
 
     symtab -> pop();
+    AttachLoopHints(headBlk,currBlk);
     
  //   irgen -> footStack -> pop();
     irgen -> brkStack -> pop();
@@ -310,11 +789,15 @@ void IfStmt::PrintChildren(int indentLevel) {
 
 
 llvm::Value* IfStmt::Emit()  {    
+    if(irgen -> IsSPMD())
+        return EmitSPMD();
+
     llvm::LLVMContext* con = irgen -> GetContext();
     llvm::Function* func = irgen -> GetFunction();
 
 
     // Emit Test
+    test -> EmitDebugLocation();
     llvm::Value* Val = test -> Emit();
 
    
@@ -325,6 +808,9 @@ llvm::Value* IfStmt::Emit()  {
     if(elseBody != NULL)
         elseBlk = llvm::BasicBlock::Create(*con,"else",func);
     llvm::BasicBlock* footBlk = llvm::BasicBlock::Create(*con,"IFfooter",func);
+    irgen -> CountBlock(thenBlk);
+    irgen -> CountBlock(elseBlk);
+    irgen -> CountBlock(footBlk);
     
     // Push footer? 
     irgen -> footStack -> push(footBlk);
@@ -338,6 +824,7 @@ llvm::Value* IfStmt::Emit()  {
     symtab -> push();
 
     irgen -> SetBasicBlock(thenBlk);
+    body -> EmitDebugLocation();
     body -> Emit();
     llvm::BasicBlock* checkBlk = irgen -> GetBasicBlock();
     if(checkBlk->getTerminator() == NULL)
@@ -350,6 +837,7 @@ llvm::Value* IfStmt::Emit()  {
         symtab -> push();
 
         irgen -> SetBasicBlock(elseBlk);
+        elseBody -> EmitDebugLocation();
         elseBody -> Emit();
         checkBlk = irgen -> GetBasicBlock();
         if(checkBlk->getTerminator() == NULL)
@@ -383,8 +871,69 @@ llvm::Value* IfStmt::Emit()  {
 
 
 
+// SPMD if: each arm runs with the lanes that take it enabled, and is
+// skipped with a branch when none of them do.
+llvm::Value* IfStmt::EmitSPMD()  {
+    llvm::LLVMContext* con = irgen -> GetContext();
+    llvm::Function* func = irgen -> GetFunction();
+
+    // Emit Test
+    test -> EmitDebugLocation();
+    llvm::Value* val = test -> Emit();
+    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
+    llvm::Value* mask = irgen -> GetMask();
+    llvm::Value* thenMask = llvm::BinaryOperator::CreateAnd(mask,val,"",currBlk);
+
+    // Create Blocks
+    llvm::BasicBlock* thenBlk = llvm::BasicBlock::Create(*con,"then",func);
+    llvm::BasicBlock* elseBlk = NULL;
+    llvm::BasicBlock* testBlk = NULL;
+    if(elseBody != NULL)  {
+        testBlk = llvm::BasicBlock::Create(*con,"IFelsetest",func);
+        elseBlk = llvm::BasicBlock::Create(*con,"else",func);
+    }
+    llvm::BasicBlock* footBlk = llvm::BasicBlock::Create(*con,"IFfooter",func);
+    llvm::BasicBlock* nextBlk = elseBody ? testBlk : footBlk;
+
+    llvm::BranchInst::Create(thenBlk,nextBlk,irgen->AnyLane(thenMask,currBlk),currBlk);
+
+    symtab -> push();
+    irgen -> SetBasicBlock(thenBlk);
+    irgen -> PushMask(thenMask);
+    body -> EmitDebugLocation();
+    body -> Emit();
+    irgen -> PopMask();
+    llvm::BranchInst::Create(nextBlk,irgen->GetBasicBlock());
+    symtab -> pop();
+
+    // Emit ElseBody if needed
+    if(elseBody != NULL)  {
+        llvm::Value* notVal = llvm::BinaryOperator::CreateNot(val,"",testBlk);
+        llvm::Value* elseMask = llvm::BinaryOperator::CreateAnd(mask,notVal,"",testBlk);
+        llvm::BranchInst::Create(elseBlk,footBlk,irgen->AnyLane(elseMask,testBlk),testBlk);
+
+        symtab -> push();
+        irgen -> SetBasicBlock(elseBlk);
+        irgen -> PushMask(elseMask);
+        elseBody -> EmitDebugLocation();
+        elseBody -> Emit();
+        irgen -> PopMask();
+        llvm::BranchInst::Create(footBlk,irgen->GetBasicBlock());
+        symtab -> pop();
+    }
+
+    irgen -> SetBasicBlock(footBlk);
+
+    return NULL;
+}
+
+
+
+
 llvm::Value* BreakStmt::Emit()  {
     hasReturned = true;
+    if(irgen -> IsSPMD())
+        return EmitSPMD();
 
     llvm::BasicBlock *blk = irgen -> GetBasicBlock();
     llvm::BasicBlock *target = irgen -> brkStack -> top();
@@ -398,7 +947,20 @@ llvm::Value* BreakStmt::Emit()  {
 
 
 
+// SPMD: the lanes running the break leave the loop
+llvm::Value* BreakStmt::EmitSPMD()  {
+    irgen -> KillLanes(irgen->brkMaskStack.back());
+
+    return NULL;
+}
+
+
+
+
 llvm::Value* ContinueStmt::Emit()  {
+    if(irgen -> IsSPMD())
+        return EmitSPMD();
+
     llvm::BasicBlock *blk = irgen -> GetBasicBlock();
     llvm::BasicBlock *target = irgen -> contStack -> top();
     llvm::BranchInst::Create(target,blk);
@@ -413,6 +975,16 @@ llvm::Value* ContinueStmt::Emit()  {
 
 
 
+// SPMD: the lanes running the continue sit out the rest of this iteration
+llvm::Value* ContinueStmt::EmitSPMD()  {
+    irgen -> KillLanes(irgen->contMaskStack.back());
+
+    return NULL;
+}
+
+
+
+
 ReturnStmt::ReturnStmt(yyltype loc, Expr *e) : Stmt(loc) { 
     expr = e;
     if (e != NULL) expr->SetParent(this);
@@ -425,6 +997,8 @@ void ReturnStmt::PrintChildren(int indentLevel) {
 
 
 llvm::Value* ReturnStmt::Emit() {
+    if(irgen -> IsSPMD())
+        return EmitSPMD();
 
     llvm::Value* val = NULL;
     if(expr != NULL){ 
@@ -448,6 +1022,21 @@ llvm::Value* ReturnStmt::Emit() {
 
 
 
+// SPMD: store the value for the active lanes, then retire them; the
+// function returns the collected values once every statement has run
+llvm::Value* ReturnStmt::EmitSPMD() {
+    if(expr != NULL)  {
+        llvm::Value* val = expr -> Emit();
+        irgen -> CreateStore(val,irgen->retSlot,irgen->GetBasicBlock());
+    }
+    irgen -> KillLanes(irgen->liveSlot);
+
+    return NULL;
+}
+
+
+
+
 SwitchLabel::SwitchLabel(Expr *l, Stmt *s) {
     Assert(l != NULL && s != NULL);
     (label=l)->SetParent(this);
@@ -467,6 +1056,7 @@ void SwitchLabel::PrintChildren(int indentLevel) {
 
 
 llvm::Value* Case::Emit() {
+    stmt -> EmitDebugLocation();
     stmt -> Emit();
 
     return NULL;
@@ -474,6 +1064,7 @@ llvm::Value* Case::Emit() {
 
 
 llvm::Value* Default::Emit() {
+    stmt -> EmitDebugLocation();
     stmt -> Emit();
 
     return NULL;
@@ -493,89 +1084,187 @@ void SwitchStmt::PrintChildren(int indentLevel) {
     if (def) def->Print(indentLevel+1);
 }
 
-llvm::Value* SwitchStmt::Emit() {
-    llvm::Function* func = irgen -> GetFunction();
-    llvm::LLVMContext *con = irgen -> GetContext();
-
-    vector<llvm::BasicBlock*> caseBlockList;
-    llvm::BasicBlock* currBlk = irgen -> GetBasicBlock();
-    llvm::BasicBlock* defBlk = llvm::BasicBlock::Create(*con,"default",func);
-    llvm::BasicBlock* footBlk = llvm::BasicBlock::Create(*con,"SWTfooter",func);
-
-    irgen -> brkStack -> push(footBlk);
+// Switch lowering. A switch on a constant branches straight to its label.
+// Otherwise the labels are sorted and measured: at least MinJumpTableCases
+// labels filling JumpTableDensity or more of their range are dense and get
+// a jump table, a constant array of block addresses indexed by the value
+// minus the smallest label and read by an indirectbr, so the table is
+// there at every -O level and in the code glc --run JITs. Sparse labels
+// become a balanced tree of compares.
+static const int MinJumpTableCases = 4;
+static const double JumpTableDensity = 0.4;
 
-    for(int i = 0 ; i < cases->NumElements(); i++)  {
-        if(dynamic_cast<Case*>(cases->Nth(i)))  {
-            llvm::BasicBlock* caseBlk = llvm::BasicBlock::Create(*con,"case",func);
-            caseBlockList.push_back(caseBlk);
-        }
-        else if (dynamic_cast<Default*>(cases->Nth(i))) {
-            caseBlockList.push_back(defBlk);
-        }
-    }
+typedef pair<llvm::ConstantInt*, llvm::BasicBlock*> SwitchCase;
 
-    //push scope?
-    symtab -> push();
+static bool CaseLess(const SwitchCase &a, const SwitchCase &b) {
+    return a.first->getSExtValue() < b.first->getSExtValue();
+}
 
-    // Emit Expression
-    llvm::Value* val = expr -> Emit();
+// Binary search over cases [lo,hi) ending in an equality test at each leaf
+static void EmitCompareTree(IRGenerator *irgen, llvm::Value *val, vector<SwitchCase> &cases,
+                            int lo, int hi, llvm::BasicBlock *defBlk, llvm::BasicBlock *blk) {
+    llvm::LLVMContext *con = irgen -> GetContext();
+    llvm::Function* func = irgen -> GetFunction();
+    irgen -> SetBasicBlock(blk);
+    IRGenerator::FoldingBuilder& builder = irgen -> Builder();
 
-  
-    //Create Switch Instruction
-    llvm::SwitchInst* swInst = llvm::SwitchInst::Create(val,footBlk,cases->NumElements(),currBlk);
+    if(hi - lo == 1) {
+        llvm::Value* eq = builder.CreateICmpEQ(val, cases[lo].first, "SWTeq");
+        builder.CreateCondBr(eq, cases[lo].second, defBlk);
+        return;
+    }
 
-    currBlk = irgen -> GetBasicBlock();    
+    int mid = (lo + hi) / 2;
+    llvm::BasicBlock* lessBlk = llvm::BasicBlock::Create(*con,"SWTless",func);
+    llvm::BasicBlock* geqBlk = llvm::BasicBlock::Create(*con,"SWTgeq",func);
+    irgen -> CountBlock(lessBlk);
+    irgen -> CountBlock(geqBlk);
+    llvm::Value* less = builder.CreateICmpSLT(val, cases[mid].first, "SWTlt");
+    builder.CreateCondBr(less, lessBlk, geqBlk);
 
+    EmitCompareTree(irgen, val, cases, lo, mid, defBlk, lessBlk);
+    EmitCompareTree(irgen, val, cases, mid, hi, defBlk, geqBlk);
+}
 
-    for (int i = 0; i < cases->NumElements(); i++)  {
-        hasReturned = false;
 
-        llvm::BasicBlock* blk = caseBlockList[i];
+// Range check, then an indirectbr through a table with one entry per value
+// in [min,min+range); values without a label go to the default
+static void EmitJumpTable(IRGenerator *irgen, llvm::Value *val, vector<SwitchCase> &cases,
+                          uint64_t range, llvm::BasicBlock *defBlk) {
+    llvm::LLVMContext *con = irgen -> GetContext();
+    llvm::Function* func = irgen -> GetFunction();
+    IRGenerator::FoldingBuilder& builder = irgen -> Builder();
+
+    vector<llvm::Constant*> entries(range, llvm::BlockAddress::get(func, defBlk));
+    int64_t min = cases[0].first->getSExtValue();
+    for(size_t i = 0; i < cases.size(); i++)
+        entries[cases[i].first->getSExtValue() - min] = llvm::BlockAddress::get(func, cases[i].second);
+
+    llvm::ArrayType* tableTy = llvm::ArrayType::get(llvm::Type::getInt8PtrTy(*con), range);
+    llvm::GlobalVariable* table = new llvm::GlobalVariable(*func->getParent(), tableTy, true,
+                                                           llvm::GlobalValue::PrivateLinkage,
+                                                           llvm::ConstantArray::get(tableTy, entries),
+                                                           "SWTtable");
+    table -> setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+
+    llvm::Value* idx = builder.CreateSub(val, cases[0].first, "SWTidx");
+    llvm::Value* inRange = builder.CreateICmpULT(idx, llvm::ConstantInt::get(val->getType(), range), "SWTin");
+    llvm::BasicBlock* jumpBlk = llvm::BasicBlock::Create(*con,"SWTjump",func);
+    irgen -> CountBlock(jumpBlk);
+    builder.CreateCondBr(inRange, jumpBlk, defBlk);
+
+    irgen -> SetBasicBlock(jumpBlk);
+    llvm::Value* zero = llvm::ConstantInt::get(val->getType(), 0);
+    llvm::Value* slot = builder.CreateInBoundsGEP(table, {zero, idx}, "SWTslot");
+    llvm::Value* addr = builder.CreateLoad(slot, "SWTaddr");
+    llvm::IndirectBrInst* br = builder.CreateIndirectBr(addr, cases.size() + 1);
+    br -> addDestination(defBlk);
+    for(size_t i = 0; i < cases.size(); i++)
+        br -> addDestination(cases[i].second);
+}
 
-        symtab -> push();
-          
-        if(dynamic_cast<Case*>(cases->Nth(i))) {
 
-            Case* ca = dynamic_cast<Case*>(cases->Nth(i));
-            llvm::Value* label = ca->GetLabel()->Emit();
+llvm::Value* SwitchStmt::Emit() {
+    if(irgen -> IsSPMD())
+        Failure("switch statements are not supported with -spmd");
 
-            swInst -> addCase(llvm::cast<llvm::ConstantInt>(label),blk);
-            
-            if(currBlk -> getTerminator() == NULL)
-                llvm::BranchInst::Create(blk,currBlk);
+    llvm::Function* func = irgen -> GetFunction();
+    llvm::LLVMContext *con = irgen -> GetContext();
 
-            irgen->SetBasicBlock(blk);
-            ca -> Emit();
+    // Emit Expression
+    expr -> EmitDebugLocation();
+    llvm::Value* val = expr -> Emit();
+    if(!val -> getType() -> isIntegerTy())
+        Failure("switch expression is not an integer");
 
-            if(hasReturned == false) {
-                if( i+1 < cases->NumElements()) {
-                    llvm::BranchInst::Create(caseBlockList[i+1],blk);
-                }
-                else
-                    llvm::BranchInst::Create(footBlk,blk);
-            }
+    llvm::BasicBlock* switchBlk = irgen -> GetBasicBlock();
+    llvm::BasicBlock* footBlk = llvm::BasicBlock::Create(*con,"SWTfooter",func);
+    irgen -> CountBlock(footBlk);
+    llvm::BasicBlock* defBlk = footBlk;
 
+    //One block per label, in source order
+    vector<llvm::BasicBlock*> labelBlocks;
+    vector<SwitchCase> switchCases;
+    for(int i = 0 ; i < cases->NumElements(); i++)  {
+        if(Case* ca = dynamic_cast<Case*>(cases->Nth(i)))  {
+            llvm::BasicBlock* caseBlk = llvm::BasicBlock::Create(*con,"SWTcase",func,footBlk);
+            irgen -> CountBlock(caseBlk);
+            llvm::ConstantInt* label = llvm::dyn_cast<llvm::ConstantInt>(ca->GetLabel()->Emit());
+            if(label == NULL)
+                Failure("case label is not a constant integer");
+            label = llvm::ConstantInt::get(llvm::cast<llvm::IntegerType>(val->getType()), label->getSExtValue(), true);
+
+            switchCases.push_back(SwitchCase(label,caseBlk));
+            labelBlocks.push_back(caseBlk);
         }
-        else if (dynamic_cast<Default*>(cases->Nth(i)))  {
-            
-            if(currBlk -> getTerminator() == NULL)
-                llvm::BranchInst::Create(defBlk,currBlk);
-
-            swInst -> setDefaultDest(defBlk);
+        else if (dynamic_cast<Default*>(cases->Nth(i))) {
+            defBlk = llvm::BasicBlock::Create(*con,"SWTdefault",func,footBlk);
+            irgen -> CountBlock(defBlk);
+            labelBlocks.push_back(defBlk);
+        }
+    }
 
-            Default* defStmt = dynamic_cast<Default*>(cases->Nth(i));
+    std::sort(switchCases.begin(), switchCases.end(), CaseLess);
+    for(size_t i = 1; i < switchCases.size(); i++)
+        if(switchCases[i].first == switchCases[i-1].first)
+            Failure("duplicate case value %lld in switch", (long long) switchCases[i].first->getSExtValue());
+
+    //Lower the dispatch
+    irgen -> SetBasicBlock(switchBlk);
+    int n = switchCases.size();
+    if(llvm::ConstantInt* c = llvm::dyn_cast<llvm::ConstantInt>(val))  {
+        llvm::BasicBlock* target = defBlk;
+        for(int i = 0; i < n; i++)
+            if(switchCases[i].first->getSExtValue() == c->getSExtValue())
+                target = switchCases[i].second;
+
+        PrintDebug("switch", "constant switch folded to %s\n", target->getName().str().c_str());
+        irgen -> Builder().CreateBr(target);
+    }
+    else {
+        double range = 1.0;
+        if(n > 0)
+            range += (double) switchCases[n-1].first->getSExtValue() - switchCases[0].first->getSExtValue();
+        bool dense = n >= MinJumpTableCases && n >= JumpTableDensity * range;
+
+        if(dense) {
+            PrintDebug("switch", "%d cases, density %.2f: jump table\n", n, n / range);
+            EmitJumpTable(irgen, val, switchCases, (uint64_t) range, defBlk);
+        }
+        else if(n > 0) {
+            PrintDebug("switch", "%d cases, density %.2f: compare tree\n", n, n / range);
+            EmitCompareTree(irgen, val, switchCases, 0, n, defBlk, switchBlk);
+        }
+        else
+            irgen -> Builder().CreateBr(defBlk);
+    }
 
-            irgen->SetBasicBlock(blk);
-            defStmt -> Emit();
+    //Emit Body
+    irgen -> brkStack -> push(footBlk);
+    symtab -> push();
 
+    size_t label = 0;
+    for (int i = 0; i < cases->NumElements(); i++)  {
+        Stmt* stmt = cases->Nth(i);
+
+        if(dynamic_cast<SwitchLabel*>(stmt))  {
+            //Fall through from the previous label
+            llvm::BasicBlock* blk = labelBlocks[label++];
+            if(irgen -> GetBasicBlock() -> getTerminator() == NULL)
+                irgen -> Builder().CreateBr(blk);
+            irgen -> SetBasicBlock(blk);
+        }
+        else if(irgen -> GetBasicBlock() -> getTerminator() != NULL)  {
+            //Code before the first label or after a break or return
+            irgen -> SetBasicBlock(llvm::BasicBlock::Create(*con,"SWTdead",func,footBlk));
         }
 
-        symtab->pop();
+        stmt -> EmitDebugLocation();
+        stmt -> Emit();
     }
 
-
-    if(defBlk -> getTerminator() == NULL)
-        llvm::BranchInst::Create(footBlk,defBlk);
+    if(irgen -> GetBasicBlock() -> getTerminator() == NULL)
+        irgen -> Builder().CreateBr(footBlk);
 
     irgen -> brkStack -> pop();
     symtab -> pop();
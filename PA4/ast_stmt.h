@@ -18,6 +18,7 @@
 
 class Decl;
 class VarDecl;
+struct ParallelEmit;
 class Expr;
 class IntConstant;
   
@@ -33,6 +34,11 @@ class Program : public Node
      const char *GetPrintNameForNode() { return "Program"; }
      void PrintChildren(int indentLevel);
      virtual llvm::Value* Emit();
+
+     // -j<N>: every function in a module of its own, emitted on N threads
+     // and linked back in source order
+     void EmitParallel(int jobs);
+     void EmitFunctionModule(ParallelEmit *work, int k);
 };
 
 class Stmt : public Node
@@ -87,11 +93,23 @@ class ConditionalStmt : public Stmt
 
 class LoopStmt : public ConditionalStmt 
 {
+  protected:
+    // From #pragma unroll(N) / nounroll (1) and #pragma vectorize(width);
+    // 0 leaves the choice to the optimizer
+    int unroll, vectorize;
+
   public:
     LoopStmt(Expr *testExpr, Stmt *body)
-            : ConditionalStmt(testExpr, body) {}
+            : ConditionalStmt(testExpr, body), unroll(0), vectorize(0) {}
+
+    void SetUnroll(int count) { unroll = count; }
+    void SetVectorize(int width) { vectorize = width; }
 
     virtual llvm::Value* Emit() {return NULL;}
+
+  protected:
+    llvm::Value* EmitSPMD(Expr *init, Expr *step);
+    void AttachLoopHints(llvm::BasicBlock *headBlk, llvm::BasicBlock *entryBlk);
 };
 
 class ForStmt : public LoopStmt 
@@ -131,6 +149,7 @@ class IfStmt : public ConditionalStmt
     void PrintChildren(int indentLevel);
 
     virtual llvm::Value* Emit();
+    llvm::Value* EmitSPMD();
 
 };
 
@@ -148,6 +167,7 @@ class BreakStmt : public Stmt
     const char *GetPrintNameForNode() { return "BreakStmt"; }
 
     virtual llvm::Value* Emit();
+    llvm::Value* EmitSPMD();
 
 };
 
@@ -158,6 +178,7 @@ class ContinueStmt : public Stmt
     const char *GetPrintNameForNode() { return "ContinueStmt"; }
 
     virtual llvm::Value* Emit();
+    llvm::Value* EmitSPMD();
 
 };
 
@@ -172,6 +193,7 @@ class ReturnStmt : public Stmt
     void PrintChildren(int indentLevel);
 
     virtual llvm::Value* Emit();
+    llvm::Value* EmitSPMD();
 
 };
 
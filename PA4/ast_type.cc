@@ -89,6 +89,11 @@ llvm::Type *Type::GetllvmType()  {
         return irgen -> GetBoolType();
     else if(this -> IsEquivalentTo(Type::floatType))
         return irgen -> GetFloatType();
+    else if(irgen -> IsSPMD() && dynamic_cast<ArrayType*>(this))
+        Failure("array types are not supported with -spmd");
+    else if(irgen -> IsSPMD() && (IsVector() || IsMatrix()))
+        // a lane of an SPMD value is a scalar; there is no vector of vectors
+        Failure("type %s is not supported with -spmd", typeName);
     else if(this -> IsEquivalentTo(Type::vec2Type))
         return irgen -> GetVec2Type();
     else if(this -> IsEquivalentTo(Type::vec3Type))
@@ -0,0 +1,67 @@
+#!/bin/bash
+#
+# Simple benchmark for the -O pipelines. For each optimization level it
+# compiles every sample in samples/ and reports the total compile time
+# to bitcode and to native objects (-emit=obj), the number of IR
+# instructions left in the emitted modules, and the
+# time to JIT and run every sample that has a .dat file (glc --run).
+# It then times the 256-way switch in a hot loop (samples/switch256) at
+# every level; its labels are dense, so it is a jump table (an indirectbr
+# through a table of block addresses) at every level. Finally it runs one sample as a batch of invocations on the
+# executor to show how throughput scales with the number of threads.
+#
+# $ make && ./bench.sh
+#
+
+GLC=./glc
+SAMPLES=samples/*.glsl
+LEVELS="0 1 2 3"
+BATCH=4000000
+TMP=$(mktemp -d)
+
+trap "rm -rf $TMP" EXIT
+
+printf "%-6s %12s %12s %12s %12s\n" "level" "compile(ms)" "obj(ms)" "instrs" "run(ms)"
+
+for level in $LEVELS; do
+    start=$(date +%s%N)
+    for f in $SAMPLES; do
+        $GLC -O$level < $f > $TMP/$(basename $f .glsl).bc
+    done
+    end=$(date +%s%N)
+
+    objStart=$(date +%s%N)
+    for f in $SAMPLES; do
+        $GLC -O$level -emit=obj -o $TMP/$(basename $f .glsl).o < $f
+    done
+    objEnd=$(date +%s%N)
+
+    instrs=0
+    for f in $SAMPLES; do
+        n=$($GLC -O$level -emit=ll < $f | grep -c '^  [%a-z]')
+        instrs=$((instrs + n))
+    done
+
+    runStart=$(date +%s%N)
+    for dat in samples/*.dat; do
+        $GLC -O$level --run $dat < samples/$(basename $dat .dat).glsl > /dev/null
+    done
+    runEnd=$(date +%s%N)
+
+    printf "%-6s %12d %12d %12d %12d\n" "-O$level" $(((end - start) / 1000000)) \
+           $(((objEnd - objStart) / 1000000)) $instrs $(((runEnd - runStart) / 1000000))
+done
+
+echo
+echo "switch256 (256-way switch, 100000 iterations)"
+echo "(a jump table through indirectbr at every level)"
+for level in $LEVELS; do
+    start=$(date +%s%N)
+    $GLC -O$level --run samples/switch256.dat < samples/switch256.glsl > /dev/null
+    end=$(date +%s%N)
+    printf "%-6s %12d ms\n" "-O$level" $(((end - start) / 1000000))
+done
+
+echo
+echo "executor scaling (for_loop, -O2, $BATCH invocations)"
+$GLC -O2 --run samples/for_loop.dat --bench $BATCH < samples/for_loop.glsl
@@ -0,0 +1,310 @@
+/* File: cache.cc
+ * --------------
+ * Implementation of the --cache compile cache.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "cache.h"
+#include "codegen.h"
+#include "utility.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+static const char IndexMagic[8] = { 'g', 'l', 'c', 'c', 'a', 'c', 'h', 'e' };
+static const uint32_t IndexVersion = 1;
+static const int DefaultLimitMB = 256;
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;         // entries following the header
+    uint64_t clock;         // bumped on every use, orders the entries for LRU
+};
+
+struct IndexEntry {
+    uint8_t key[16];        // entries are sorted by key
+    uint64_t size;
+    uint64_t lastUse;
+};
+
+static bool haveKey = false;
+static uint8_t key[16];
+
+// Options that only say where the output goes or what else is printed
+static const char *IgnoredOptions[] = { "o", "cache", "cache-size", "time-report", NULL };
+
+// A hit skips the parser and Program::Emit, so -d output would vanish
+bool CacheEnabled() {
+    return GetOptionForKey("cache") != NULL && GetOptionForKey("run") == NULL &&
+           GetOptionForKey("stats") == NULL && !AnyDebugOn();
+}
+
+// Identifies the glc build by the size and modification time of its
+// executable, so a rebuilt compiler never reuses an older one's output
+static std::string BuildId() {
+    std::string exe = llvm::sys::fs::getMainExecutable(NULL, (void *)&BuildId);
+    struct stat st;
+    if (exe.empty() || stat(exe.c_str(), &st) != 0)
+        return "unknown build";
+
+    char id[64];
+    snprintf(id, sizeof(id), "%lld %lld.%09ld", (long long)st.st_size,
+             (long long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+    return id;
+}
+
+static bool IsIgnored(const char *option) {
+    for (int i = 0; IgnoredOptions[i] != NULL; i++)
+        if (strcmp(IgnoredOptions[i], option) == 0)
+            return true;
+    return false;
+}
+
+static void ComputeKey(const char *source, size_t len) {
+    llvm::MD5 hash;
+    hash.update("glc cache 1\n" LLVM_VERSION_STRING "\n");
+    hash.update(BuildId() + "\n");
+    hash.update(llvm::sys::getProcessTriple() + "\n");
+    hash.update(GetTargetCPU() + " " + GetTargetFeatures() + "\n");
+
+    // -j<N> gives the same output for every N. It runs the same pipeline as
+    // no -j, but the module may list its declarations in another order, so
+    // the two are kept apart to stay byte for byte
+    std::vector<std::string> options;
+    for (int i = 0; i < NumOptions(); i++) {
+        const char *option = GetNthOptionKey(i);
+        if (IsIgnored(option))
+            continue;
+        if (strcmp(option, "jobs") == 0)
+            options.push_back("jobs");
+        else
+            options.push_back(std::string(option) + "=" + GetNthOptionValue(i));
+    }
+    std::sort(options.begin(), options.end());
+    for (size_t i = 0; i < options.size(); i++)
+        hash.update(options[i] + "\n");
+
+    // -fprofile-use: the output depends on the profile, not on its name
+    if (GetOptionForKey("profile-use") != NULL) {
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > profile =
+            llvm::MemoryBuffer::getFile(GetOptionForKey("profile-use"));
+        if (profile)
+            hash.update(profile.get()->getBuffer());
+    }
+
+    hash.update(llvm::StringRef(source, len));
+
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    memcpy(key, &result, sizeof(key));
+    haveKey = true;
+}
+
+static std::string ObjectPath(const std::string &dir, const uint8_t *k) {
+    char name[2*16 + 1];
+    for (int i = 0; i < 16; i++)
+        sprintf(name + 2*i, "%02x", k[i]);
+    return dir + "/objects/" + name;
+}
+
+// Held across every read-modify-write of the index; closing the
+// descriptor releases the lock
+static int LockCache(const std::string &dir) {
+    int fd = open((dir + "/lock").c_str(), O_RDWR | O_CREAT, 0666);
+    if (fd >= 0 && flock(fd, LOCK_EX) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Returns the index mapped read-write, or NULL if there is no valid one
+static IndexHeader *MapIndex(const std::string &dir, size_t &mapped) {
+    int fd = open((dir + "/index").c_str(), O_RDWR);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(IndexHeader))
+        p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return NULL;
+
+    IndexHeader *header = (IndexHeader*) p;
+    if (memcmp(header->magic, IndexMagic, sizeof(IndexMagic)) != 0 ||
+        header->version != IndexVersion ||
+        (size_t) st.st_size != sizeof(IndexHeader) + header->count * sizeof(IndexEntry)) {
+        munmap(p, st.st_size);
+        return NULL;
+    }
+    mapped = st.st_size;
+    return header;
+}
+
+static IndexEntry *Entries(IndexHeader *header) {
+    return (IndexEntry*) (header + 1);
+}
+
+static bool EntryLess(const IndexEntry &entry, const uint8_t *k) {
+    return memcmp(entry.key, k, sizeof(entry.key)) < 0;
+}
+
+static IndexEntry *FindEntry(IndexHeader *header) {
+    IndexEntry *first = Entries(header);
+    IndexEntry *last = first + header->count;
+    IndexEntry *entry = std::lower_bound(first, last, (const uint8_t*) key, EntryLess);
+
+    if (entry == last || memcmp(entry->key, key, sizeof(key)) != 0)
+        return NULL;
+    return entry;
+}
+
+// Writes to a temporary file next to path and renames it into place
+static bool WriteFileAtomic(const std::string &path, const char *data, size_t size) {
+    std::string tmp = path + ".tmp" + std::to_string(getpid());
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+        return false;
+
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, data + done, size - done);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+
+    bool ok = (close(fd) == 0 && done == size);
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool CacheLookup(const char *source, size_t len) {
+    ComputeKey(source, len);
+    std::string dir = GetOptionForKey("cache");
+
+    int lock = LockCache(dir);
+    if (lock < 0)
+        return false;
+
+    // The object is opened while the lock keeps it from being evicted; an
+    // open file stays readable even if another compile removes it later
+    int fd = -1;
+    uint64_t size = 0;
+    size_t mapped;
+    IndexHeader *header = MapIndex(dir, mapped);
+    if (header != NULL) {
+        IndexEntry *entry = FindEntry(header);
+        if (entry != NULL && (fd = open(ObjectPath(dir, key).c_str(), O_RDONLY)) >= 0) {
+            entry->lastUse = ++header->clock;
+            size = entry->size;
+        }
+        munmap(header, mapped);
+    }
+    close(lock);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (uint64_t) st.st_size == size && size > 0)
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    WriteOutput((const char*) data, size);
+    munmap(data, size);
+    return true;
+}
+
+void CacheStore(const char *data, size_t size) {
+    if (!haveKey)
+        return;
+
+    std::string dir = GetOptionForKey("cache");
+    mkdir(dir.c_str(), 0777);
+    mkdir((dir + "/objects").c_str(), 0777);
+
+    if (!WriteFileAtomic(ObjectPath(dir, key), data, size))
+        return;
+
+    int lock = LockCache(dir);
+    if (lock < 0)
+        return;
+
+    std::vector<IndexEntry> entries;
+    uint64_t clock = 0;
+    size_t mapped;
+    IndexHeader *header = MapIndex(dir, mapped);
+    if (header != NULL) {
+        entries.assign(Entries(header), Entries(header) + header->count);
+        clock = header->clock;
+        munmap(header, mapped);
+    }
+
+    IndexEntry entry;
+    memcpy(entry.key, key, sizeof(key));
+    entry.size = size;
+    entry.lastUse = ++clock;
+
+    std::vector<IndexEntry>::iterator it =
+        std::lower_bound(entries.begin(), entries.end(), (const uint8_t*) key, EntryLess);
+    if (it != entries.end() && memcmp(it->key, key, sizeof(key)) == 0)
+        *it = entry;
+    else
+        entries.insert(it, entry);
+
+    // Evict the least recently used objects until the rest fit
+    uint64_t limit = (uint64_t) DefaultLimitMB << 20;
+    if (GetOptionForKey("cache-size") != NULL)
+        limit = (uint64_t) atoi(GetOptionForKey("cache-size")) << 20;
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < entries.size(); i++)
+        total += entries[i].size;
+
+    while (total > limit && !entries.empty()) {
+        std::vector<IndexEntry>::iterator lru = entries.begin();
+        for (it = entries.begin(); it != entries.end(); it++)
+            if (it->lastUse < lru->lastUse)
+                lru = it;
+
+        unlink(ObjectPath(dir, lru->key).c_str());
+        total -= lru->size;
+        entries.erase(lru);
+    }
+
+    IndexHeader newHeader;
+    memcpy(newHeader.magic, IndexMagic, sizeof(IndexMagic));
+    newHeader.version = IndexVersion;
+    newHeader.count = entries.size();
+    newHeader.clock = clock;
+
+    std::string index((const char*) &newHeader, sizeof(newHeader));
+    if (!entries.empty())
+        index.append((const char*) &entries[0], entries.size() * sizeof(IndexEntry));
+    WriteFileAtomic(dir + "/index", index.data(), index.size());
+
+    close(lock);
+}
@@ -0,0 +1,63 @@
+/**
+ * File: cache.h
+ * -------------
+ *  This file declares the on-disk compile cache enabled with
+ *  --cache <dir>.
+ *
+ *  The key of a compile is the MD5 of the source text, the options that
+ *  change the output (-O, -march, -spmd, -emit, ...), the target triple,
+ *  the host CPU and features for -march=native, the -fprofile-use profile,
+ *  the LLVM version and the size and modification time of the glc
+ *  executable, so a rebuilt compiler starts over. On a hit the stored
+ *  output is written as is and neither the parser nor Program::Emit run.
+ *
+ *  The directory holds
+ *
+ *     objects/<key>   the output of one compile (bitcode, IR, asm or obj)
+ *     index           a header and a key-sorted array of fixed-size
+ *                     entries (key, size, last use), read through mmap
+ *     lock            flock()ed while the index is read or changed
+ *
+ *  Objects and the index are written to a temporary file and renamed into
+ *  place, so a reader never sees a partial file. When the objects add up
+ *  to more than --cache-size megabytes (default 256) the least recently
+ *  used ones are removed. The cache is skipped for --run, --stats and
+ *  -d, whose output is not only the compiled file; errors in the cache
+ *  directory only turn a hit into a miss.
+ */
+
+#ifndef _H_cache
+#define _H_cache
+
+#include <stddef.h>
+
+/**
+ * Function: CacheEnabled()
+ * Usage: if (CacheEnabled()) ...
+ * ------------------------------
+ * Returns true if --cache was given and the output can be cached.
+ */
+
+bool CacheEnabled();
+
+/**
+ * Function: CacheLookup()
+ * Usage: if (CacheLookup(source, len)) return 0;
+ * ----------------------------------------------
+ * Computes the key of source under the current options. On a hit the
+ * stored output is written (see WriteOutput) and true is returned.
+ */
+
+bool CacheLookup(const char *source, size_t len);
+
+/**
+ * Function: CacheStore()
+ * Usage: CacheStore(data, size);
+ * ------------------------------
+ * Stores the output of this compile under the key computed by
+ * CacheLookup and evicts the least recently used entries over the limit.
+ */
+
+void CacheStore(const char *data, size_t size);
+
+#endif
@@ -0,0 +1,41 @@
+#!/bin/bash
+#
+# Codegen size check. For every samples/<name>.count file, compiles
+# samples/<name>.glsl and compares the number of instructions emitted for
+# each listed opcode against the expected count. The .count files hold
+# one "<opcode> <count>" pair per line. The --stats=json report of
+# swizzle_ops must parse as JSON and give its function the same counts.
+#
+# $ make && ./check_counts.sh
+#
+
+GLC=./glc
+status=0
+
+for count in samples/*.count; do
+    name=$(basename $count .count)
+    ir=$($GLC -emit=ll < samples/$name.glsl)
+
+    while read opcode expected; do
+        actual=$(echo "$ir" | grep -c "= $opcode \|^  $opcode ")
+        if [ "$actual" != "$expected" ]; then
+            echo "$name: $opcode expected $expected, got $actual"
+            status=1
+        fi
+    done < $count
+done
+
+stats=$(mktemp)
+$GLC --stats=json --stats-file $stats -emit=ll < samples/swizzle_ops.glsl > /dev/null
+actual=$(python3 -c '
+import json, sys
+funcs = [f for f in json.load(sys.stdin)["functions"] if f["name"] == "swizzle"]
+for f in funcs:
+    print(f["extractelement"], f["insertelement"], f["opcodes"].get("shufflevector", 0))' < $stats)
+rm -f $stats
+if [ "$actual" != "5 2 11" ]; then
+    echo "swizzle_ops: --stats=json expected '5 2 11' extract/insert/shufflevector, got '$actual'"
+    status=1
+fi
+
+exit $status
@@ -0,0 +1,153 @@
+#!/bin/bash
+#
+# Runs every sample that has a .dat file in-process with glc --run and
+# compares the printed result against samples/<name>.out. The spmd_*
+# samples are run a second time compiled with -spmd=8, and spmd_divergent
+# is batched over differing inputs, where each lane of the -spmd=8 kernel
+# must match the scalar shader. Every sample is run again with the
+# parallel code generator (-j4), whose output must also be the same as
+# with -j1 (the spmd_* samples also with -j4 -spmd=8), and
+# with -fbounds-check, where bounds_check must keep only the check on its
+# variable index, and with -g, which must not change any result. Each
+# sample is run once more with -fprofile-generate and compiled with the
+# profile it wrote (-fprofile-use), which must not change the result
+# either and gives profile_skew its branch weights; its module must
+# register the profile writer as a destructor. The loops of
+# loop_pragma must carry the llvm.loop hints of their pragmas. In purity,
+# the calls to the readnone and readonly functions must be marked so and
+# the repeated ones CSE'd at -O1. Finally every sample is compiled twice with
+# --cache; the second, cached output must match the first.
+#
+# $ make && ./check_samples.sh [-O<level>]
+#
+
+GLC=./glc
+status=0
+
+check() {
+    name=$(basename $1 .dat)
+    actual=$($GLC $2 $3 --run $1 < samples/$name.glsl 2>&1)
+    expected=$(cat samples/$name.out)
+
+    if [ "$actual" != "$expected" ]; then
+        echo "FAIL $name $3: expected '$expected', got '$actual'"
+        status=1
+    fi
+}
+
+for dat in samples/*.dat; do
+    check $dat $1
+done
+
+for dat in samples/spmd_*.dat; do
+    check $dat "$1" -spmd=8
+done
+
+# 1003 records, a partial last gang, each with its own input: every
+# lane of the kernel must give what the scalar shader gives
+bench="--run samples/spmd_divergent.dat --bench 1003"
+scalar=$($GLC $1 $bench < samples/spmd_divergent.glsl 2>&1 | grep "^Checksum\|differ")
+spmd=$($GLC $1 -spmd=8 $bench < samples/spmd_divergent.glsl 2>&1 | grep "^Checksum\|differ")
+if [ "$scalar" != "$spmd" ] || echo "$scalar $spmd" | grep -q differ; then
+    echo "FAIL spmd_divergent -spmd=8 --bench: expected '$scalar', got '$spmd'"
+    status=1
+fi
+
+for dat in samples/*.dat; do
+    check $dat "$1" -j4
+done
+
+for dat in samples/spmd_*.dat; do
+    check $dat "$1" "-j4 -spmd=8"
+done
+
+for glsl in samples/*.glsl; do
+    if ! cmp -s <($GLC $1 -j1 -emit=ll < $glsl 2>&1) <($GLC $1 -j4 -emit=ll < $glsl 2>&1); then
+        echo "FAIL $(basename $glsl .glsl) -j4: IR differs from -j1"
+        status=1
+    fi
+done
+
+for dat in samples/*.dat; do
+    check $dat "$1" -fbounds-check
+done
+
+checks=$($GLC $1 -fbounds-check -emit=ll < samples/bounds_check.glsl | grep -c "icmp ult")
+if [ "$checks" != "1" ]; then
+    echo "FAIL bounds_check -fbounds-check: expected 1 check, got $checks"
+    status=1
+fi
+
+for dat in samples/*.dat; do
+    check $dat "$1" -g
+done
+
+profile=$(mktemp)
+for dat in samples/*.dat; do
+    check $dat "$1" -fprofile-generate=$profile
+    check $dat "$1" -fprofile-use=$profile
+done
+
+if ! $GLC $1 -fprofile-generate=$profile -emit=ll < samples/profile_skew.glsl |
+        grep -q "@llvm.global_dtors = .*@__glc_prof_write"; then
+    echo "FAIL profile_skew -fprofile-generate: no profile writer in llvm.global_dtors"
+    status=1
+fi
+$GLC $1 -fprofile-generate=$profile --run samples/profile_skew.dat < samples/profile_skew.glsl > /dev/null
+if ! grep -q "^skewed: 1, [0-9]" $profile; then
+    echo "FAIL profile_skew -fprofile-generate: expected 'skewed: 1, ...', got '$(cat $profile)'"
+    status=1
+fi
+if ! $GLC $1 -fprofile-use=$profile -emit=ll < samples/profile_skew.glsl | grep -q "branch_weights"; then
+    echo "FAIL profile_skew -fprofile-use: no branch weights"
+    status=1
+fi
+rm -f $profile
+
+# Prints "<header> <hint> <value>, ..." for every loop with an llvm.loop
+# node, the header being the latch branch target without its number
+loop_hints() {
+    echo "$1" | grep -o "br label %[A-Za-z]*[0-9]*, !llvm.loop ![0-9]*" |
+        sed 's/br label %\([A-Za-z]*\)[0-9]*, !llvm.loop /\1 /' | sort -u |
+    while read header id; do
+        line="$header"
+        for hint in $(echo "$1" | grep "^$id = " | grep -o "![0-9][0-9]*" | tail -n +3); do
+            line="$line $(echo "$1" | grep "^$hint = " | sed 's/.*!"\([^"]*\)"\(, i[0-9]* \)\{0,1\}\([^}]*\)}.*/\1 \3/'),"
+        done
+        echo "${line%,}"
+    done | sed 's/ ,/,/g; s/ *$//' | sort
+}
+
+expected="FORhead llvm.loop.unroll.count 2, llvm.loop.vectorize.width 4, llvm.loop.vectorize.enable true
+FORhead llvm.loop.unroll.count 4
+FORhead llvm.loop.unroll.disable
+Whhead llvm.loop.unroll.disable"
+actual=$(loop_hints "$($GLC -emit=ll < samples/loop_pragma.glsl)")
+if [ "$actual" != "$expected" ]; then
+    echo "FAIL loop_pragma -emit=ll: expected loop hints '$expected', got '$actual'"
+    status=1
+fi
+
+ir=$($GLC -emit=ll < samples/purity.glsl)
+if ! echo "$ir" | grep -q "readnone" || ! echo "$ir" | grep -q "readonly"; then
+    echo "FAIL purity: functions not marked readnone and readonly"
+    status=1
+fi
+calls=$($GLC -O1 -emit=ll < samples/purity.glsl | grep -c "= call ")
+if [ "$calls" != "2" ]; then
+    echo "FAIL purity -O1: expected 2 calls, got $calls"
+    status=1
+fi
+
+cache=$(mktemp -d)
+for glsl in samples/*.glsl; do
+    compiled=$($GLC $1 -emit=ll --cache $cache < $glsl 2>&1)
+    cached=$($GLC $1 -emit=ll --cache $cache < $glsl 2>&1)
+    if [ "$compiled" != "$cached" ] || [ ! -s $cache/index ]; then
+        echo "FAIL $(basename $glsl .glsl) --cache: cached output differs"
+        status=1
+    fi
+done
+rm -rf $cache
+
+exit $status
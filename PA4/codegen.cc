@@ -0,0 +1,124 @@
+/* File: codegen.cc
+ * ----------------
+ * Output of the finished module: bitcode, textual IR, or native assembly
+ * and object code through llvm::TargetMachine.
+ */
+
+#include <string.h>
+#include <memory>
+#include "codegen.h"
+#include "cache.h"
+#include "utility.h"
+
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetOptions.h"
+
+static llvm::CodeGenOpt::Level GetCodeGenLevel() {
+    switch (GetOptLevel()) {
+      case 0:  return llvm::CodeGenOpt::None;
+      case 1:  return llvm::CodeGenOpt::Less;
+      case 2:  return llvm::CodeGenOpt::Default;
+      default: return llvm::CodeGenOpt::Aggressive;
+    }
+}
+
+std::string GetTargetCPU() {
+    const char *march = GetOptionForKey("march");
+    if (march == NULL)
+        return "generic";
+    if (strcmp(march, "native") == 0)
+        return llvm::sys::getHostCPUName();
+    return march;
+}
+
+// Only native needs an explicit list; a named CPU implies its features
+std::string GetTargetFeatures() {
+    const char *march = GetOptionForKey("march");
+    if (march == NULL || strcmp(march, "native") != 0)
+        return "";
+
+    llvm::StringMap<bool> host;
+    llvm::SubtargetFeatures features;
+    if (llvm::sys::getHostCPUFeatures(host)) {
+        for (llvm::StringMap<bool>::iterator it = host.begin(); it != host.end(); it++)
+            features.AddFeature(it->first(), it->second);
+    }
+    return features.getString();
+}
+
+llvm::TargetMachine *CreateTargetMachine(const std::string &triple) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    std::string error;
+    const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (target == NULL)
+        Failure("No target for %s: %s", triple.c_str(), error.c_str());
+
+    llvm::TargetOptions options;
+    return target->createTargetMachine(triple, GetTargetCPU(), GetTargetFeatures(),
+                                       options, llvm::Reloc::PIC_,
+                                       llvm::CodeModel::Default, GetCodeGenLevel());
+}
+
+// Object and assembly files go through the code generator's own pass
+// manager, into a buffer since the object writer patches section headers
+// after the fact.
+static void EmitNative(llvm::Module *mod, llvm::raw_pwrite_stream &os,
+                       llvm::TargetMachine::CodeGenFileType kind) {
+    std::unique_ptr<llvm::TargetMachine> tm(CreateTargetMachine(mod->getTargetTriple()));
+    mod->setDataLayout(tm->createDataLayout());
+
+    llvm::legacy::PassManager pm;
+    if (tm->addPassesToEmitFile(pm, os, kind))
+        Failure("Target %s cannot emit this file type", mod->getTargetTriple().c_str());
+    pm.run(*mod);
+}
+
+void WriteModule(llvm::Module *mod) {
+    const char *emit = GetOptionForKey("emit");
+    if (emit == NULL)
+        emit = "bc";
+
+    llvm::SmallVector<char, 0> buffer;
+    llvm::raw_svector_ostream os(buffer);
+
+    if (strcmp(emit, "bc") == 0)
+        llvm::WriteBitcodeToFile(mod, os);
+    else if (strcmp(emit, "ll") == 0)
+        mod->print(os, NULL);
+    else if (strcmp(emit, "asm") == 0)
+        EmitNative(mod, os, llvm::TargetMachine::CGFT_AssemblyFile);
+    else
+        EmitNative(mod, os, llvm::TargetMachine::CGFT_ObjectFile);
+
+    WriteOutput(buffer.data(), buffer.size());
+
+    // --cache: keep the output for the next compile of the same source
+    if (CacheEnabled())
+        CacheStore(buffer.data(), buffer.size());
+}
+
+void WriteOutput(const char *data, size_t size) {
+    const char *emit = GetOptionForKey("emit");
+    const char *path = GetOptionForKey("o");
+    if (path == NULL)
+        path = "-";     // stdout
+
+    bool text = (emit != NULL && (strcmp(emit, "ll") == 0 || strcmp(emit, "asm") == 0));
+    std::error_code ec;
+    llvm::raw_fd_ostream out(path, ec, text ? llvm::sys::fs::F_Text : llvm::sys::fs::F_None);
+    if (ec)
+        Failure("Cannot open %s: %s", path, ec.message().c_str());
+
+    out.write(data, size);
+}
@@ -0,0 +1,68 @@
+/**
+ * File: codegen.h
+ * ---------------
+ *  This file declares the back end of glc: writing the finished module
+ *  out in the form selected with -emit=<kind>.
+ *
+ *     -emit=bc     LLVM bitcode (the default)
+ *     -emit=ll     textual LLVM IR
+ *     -emit=asm    native assembly
+ *     -emit=obj    native object file
+ *
+ *  Assembly and object files are produced in-process by an
+ *  llvm::TargetMachine for the module's target triple, so no separate
+ *  llc run (and no bitcode round trip) is needed. The output is emitted
+ *  into memory and then written to the file named with -o, or to stdout.
+ */
+
+#ifndef _H_codegen
+#define _H_codegen
+
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+/**
+ * Function: GetTargetCPU(), GetTargetFeatures()
+ * Usage: func->addFnAttr("target-cpu", GetTargetCPU());
+ * -----------------------------------------------------
+ * The CPU and feature string selected with -march. -march=native uses the
+ * host CPU and the features it reports (e.g. "+avx2,+fma,-avx512f,...");
+ * -march=<cpu> names a CPU whose features LLVM knows. Without -march the
+ * CPU is "generic" and there are no extra features.
+ */
+
+std::string GetTargetCPU();
+std::string GetTargetFeatures();
+
+/**
+ * Function: CreateTargetMachine()
+ * Usage: llvm::TargetMachine *tm = CreateTargetMachine(mod->getTargetTriple());
+ * ----------------------------------------------------------------------------
+ * Returns a TargetMachine for triple and the -march CPU, with the code
+ * generation level taken from -O<level>. Calls Failure if the target is
+ * not available.
+ */
+
+llvm::TargetMachine *CreateTargetMachine(const std::string &triple);
+
+/**
+ * Function: WriteModule()
+ * Usage: WriteModule(mod);
+ * ------------------------
+ * Writes mod as selected by -emit and -o, and stores it in the compile
+ * cache if --cache was given.
+ */
+
+void WriteModule(llvm::Module *mod);
+
+/**
+ * Function: WriteOutput()
+ * Usage: WriteOutput(data, size);
+ * -------------------------------
+ * Writes an already emitted file (e.g. one from the compile cache) to the
+ * file named with -o, or to stdout.
+ */
+
+void WriteOutput(const char *data, size_t size);
+
+#endif
@@ -8,6 +8,7 @@
 #include <sstream>
 #include <stdarg.h>
 #include <stdio.h>
+#include <mutex>
 
 using namespace std;
 
@@ -19,6 +20,9 @@ using namespace std;
 
 int ReportError::numErrors = 0;
 
+// The -j workers report errors too; one message is printed at a time
+static std::mutex outputLock;
+
 void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
     if (!line) return;
     cerr << line << endl;
@@ -30,6 +34,7 @@ void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
  
  
 void ReportError::OutputError(yyltype *loc, string msg) {
+    std::lock_guard<std::mutex> guard(outputLock);
     numErrors++;
     fflush(stdout); // make sure any buffered text has been output
     if (loc) {
@@ -0,0 +1,81 @@
+/* File: executor.cc
+ * -----------------
+ * Implementation of the work-stealing executor.
+ */
+
+#include <thread>
+#include "executor.h"
+#include "utility.h"
+
+Executor::Executor(int n) : numThreads(n) {
+    Assert(n > 0);
+    for (int i = 0; i < numThreads; i++)
+        workers.push_back(new Worker);
+}
+
+Executor::~Executor() {
+    for (int i = 0; i < numThreads; i++)
+        delete workers[i];
+}
+
+// Worker i gets chunks [i*n/t, (i+1)*n/t), so neighbouring invocations
+// (and their input/output records) stay on one core unless stolen.
+void Executor::Run(int count, int grain, ChunkFn fn, void *data) {
+    Assert(grain > 0);
+    int numChunks = (count + grain - 1) / grain;
+
+    for (int i = 0; i < numThreads; i++) {
+        int first = (long long)numChunks * i / numThreads;
+        int last = (long long)numChunks * (i+1) / numThreads;
+
+        for (int c = first; c < last; c++) {
+            Chunk chunk;
+            chunk.begin = c * grain;
+            chunk.end = (c+1) * grain < count ? (c+1) * grain : count;
+            workers[i]->chunks.push_back(chunk);
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < numThreads; i++)
+        threads.push_back(std::thread(&Executor::WorkLoop, this, i, fn, data));
+
+    WorkLoop(0, fn, data);
+
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+// No chunk creates new work, so once the own deque and every victim's
+// deque are empty the worker is done.
+void Executor::WorkLoop(int self, ChunkFn fn, void *data) {
+    Chunk chunk;
+    while (PopLocal(self, chunk) || Steal(self, chunk))
+        fn(data, chunk.begin, chunk.end);
+}
+
+bool Executor::PopLocal(int self, Chunk &chunk) {
+    Worker *w = workers[self];
+    std::lock_guard<std::mutex> guard(w->lock);
+
+    if (w->chunks.empty())
+        return false;
+    chunk = w->chunks.back();
+    w->chunks.pop_back();
+    return true;
+}
+
+// Steal the chunk furthest from the one the victim is working on
+bool Executor::Steal(int self, Chunk &chunk) {
+    for (int k = 1; k < numThreads; k++) {
+        Worker *victim = workers[(self + k) % numThreads];
+        std::lock_guard<std::mutex> guard(victim->lock);
+
+        if (!victim->chunks.empty()) {
+            chunk = victim->chunks.front();
+            victim->chunks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+/**
+ * File: executor.h
+ * ----------------
+ *  This file defines a small work-stealing executor used to run a compiled
+ *  shader over a range of invocations (glc --run file.dat --bench N), and
+ *  by the parallel code generator (glc -j<N>) to emit one function each.
+ *
+ *  The range [0, count) is cut into chunks of grain invocations. Every
+ *  worker starts with a contiguous share of the chunks in its own deque and
+ *  takes work from the back of it; a worker whose deque is empty steals
+ *  from the front of another worker's deque, so an uneven share (or a slow
+ *  core) does not leave the other threads idle at the end of a batch.
+ */
+
+#ifndef _H_executor
+#define _H_executor
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+class Executor {
+  public:
+    // Runs the invocations [begin, end) of one chunk
+    typedef void (*ChunkFn)(void *data, int begin, int end);
+
+    Executor(int numThreads);
+    ~Executor();
+
+    int  NumThreads() const { return numThreads; }
+
+    // Calls fn over every chunk of [0, count) and returns once all of them
+    // have run. The calling thread is worker 0.
+    void Run(int count, int grain, ChunkFn fn, void *data);
+
+  private:
+    struct Chunk {
+      int begin, end;
+    };
+
+    struct Worker {
+      std::mutex lock;
+      std::deque<Chunk> chunks;
+    };
+
+    int numThreads;
+    std::vector<Worker*> workers;
+
+    void WorkLoop(int self, ChunkFn fn, void *data);
+    bool PopLocal(int self, Chunk &chunk);
+    bool Steal(int self, Chunk &chunk);
+};
+
+#endif
@@ -3,14 +3,39 @@
  * You can implement any LLVM related functions here.
  */
 
+#include <string.h>
+#include <algorithm>
 #include "irgen.h"
+#include "timer.h"
+#include "utility.h"
+#include "profile.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/Pass.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
 IRGenerator::IRGenerator() :
     context(NULL),
     module(NULL),
+    builder(NULL),
+    targetMachine(NULL),
     currentFunc(NULL),
-    currentBB(NULL)
+    currentBB(NULL),
+    trapBlock(NULL),
+    dibuilder(NULL),
+    debugFile(NULL),
+    compileUnit(NULL),
+    laneCount(0)
 {
+    retSlot = NULL;
+    liveSlot = NULL;
     brkStack = new std::stack<llvm::BasicBlock*>;
     contStack = new std::stack<llvm::BasicBlock*>;
     footStack = new std::stack<llvm::BasicBlock*>;
@@ -26,14 +51,263 @@ llvm::Module *IRGenerator::GetOrCreateModule(const char *moduleID)
    if ( module == NULL ) {
      context = new llvm::LLVMContext();
      module  = new llvm::Module(moduleID, *context);
-     module->setTargetTriple(TargetTriple);
-     module->setDataLayout(TargetLayout);
+     builder = new FoldingBuilder(*context);
+     if ( targetMachine != NULL ) {
+       module->setTargetTriple(targetMachine->getTargetTriple().str());
+       module->setDataLayout(targetMachine->createDataLayout());
+     }
+     else {
+       module->setTargetTriple(TargetTriple);
+       module->setDataLayout(TargetLayout);
+     }
+
+     // The source is read from stdin; DWARF has no code for GLSL
+     if ( GetOptionForKey("debug") != NULL ) {
+       dibuilder = new llvm::DIBuilder(*module);
+       debugFile = dibuilder->createFile("<stdin>", ".");
+       compileUnit = dibuilder->createCompileUnit(llvm::dwarf::DW_LANG_C99, "<stdin>", ".", "glc",
+                                                  GetOptLevel() > 0, "", 0, "",
+                                                  llvm::DICompileUnit::LineTablesOnly);
+       module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+       module->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                             llvm::DEBUG_METADATA_VERSION);
+     }
    }
    return module;
 }
 
+void IRGenerator::CreateSubprogram(llvm::Function *func, int line) {
+   if ( dibuilder == NULL )
+     return;
+
+   llvm::DISubroutineType *type =
+       dibuilder->createSubroutineType(dibuilder->getOrCreateTypeArray(llvm::None));
+   llvm::DISubprogram *sp =
+       dibuilder->createFunction(debugFile, func->getName(), func->getName(), debugFile, line,
+                                 type, false, true, line, llvm::DINode::FlagPrototyped,
+                                 GetOptLevel() > 0);
+   func->setSubprogram(sp);
+   builder->SetCurrentDebugLocation(llvm::DebugLoc::get(line, 0, sp));
+}
+
+void IRGenerator::SetDebugLocation(int line, int column) {
+   if ( dibuilder == NULL || currentFunc == NULL || currentFunc->getSubprogram() == NULL )
+     return;
+
+   StampDebugLocation();
+   builder->SetCurrentDebugLocation(llvm::DebugLoc::get(line, column, currentFunc->getSubprogram()));
+}
+
+void IRGenerator::FinishFunction() {
+   if ( dibuilder != NULL ) {
+     StampDebugLocation();
+     StampFunction();
+     builder->SetCurrentDebugLocation(llvm::DebugLoc());
+   }
+
+   if ( GetOptionForKey("profile-generate") != NULL )
+     EmitBlockCounters();
+   else if ( GetOptionForKey("profile-use") != NULL )
+     ApplyProfile();
+   countedBlocks.clear();
+}
+
+void IRGenerator::FinalizeDebugInfo() {
+   if ( dibuilder != NULL )
+     dibuilder->finalize();
+}
+
+void IRGenerator::MergeCompileUnits() {
+   if ( compileUnit == NULL )
+     return;
+
+   for ( llvm::Module::iterator f = module->begin(); f != module->end(); f++ )
+     if ( llvm::DISubprogram *sp = f->getSubprogram() )
+       sp->replaceUnit(compileUnit);
+
+   llvm::NamedMDNode *units = module->getNamedMetadata("llvm.dbg.cu");
+   if ( units != NULL ) {
+     units->clearOperands();
+     units->addOperand(compileUnit);
+   }
+}
+
+// Many instructions are created with "new X(..., bb)" rather than through
+// the builder; they get the location in effect when they were emitted.
+// Emission appends to the blocks entered since the last call, so each is
+// walked only past the last instruction stamped in it; allocas stamp
+// themselves.
+void IRGenerator::StampDebugLocation() {
+   const llvm::DebugLoc &loc = builder->getCurrentDebugLocation();
+   if ( !loc || currentFunc == NULL )
+     return;
+
+   if ( currentBB != NULL )
+     unstampedBlocks.insert(currentBB);
+
+   for ( std::set<llvm::BasicBlock*>::iterator bb = unstampedBlocks.begin(); bb != unstampedBlocks.end(); bb++ ) {
+     llvm::WeakVH &mark = stampedUpTo[*bb];
+     llvm::BasicBlock::iterator i = (*bb)->begin();
+     if ( mark != NULL )
+       i = ++llvm::cast<llvm::Instruction>((llvm::Value *) mark)->getIterator();
+
+     for ( ; i != (*bb)->end(); i++ )
+       if ( !i->getDebugLoc() )
+         i->setDebugLoc(loc);
+
+     if ( !(*bb)->empty() )
+       mark = &(*bb)->back();
+   }
+   unstampedBlocks.clear();
+}
+
+// Anything inserted ahead of a block's last stamped instruction, or into
+// a block that was never entered, gets the function's last location
+void IRGenerator::StampFunction() {
+   const llvm::DebugLoc &loc = builder->getCurrentDebugLocation();
+   if ( !loc || currentFunc == NULL )
+     return;
+
+   for ( llvm::Function::iterator bb = currentFunc->begin(); bb != currentFunc->end(); bb++ )
+     for ( llvm::BasicBlock::iterator i = bb->begin(); i != bb->end(); i++ )
+       if ( !i->getDebugLoc() )
+         i->setDebugLoc(loc);
+}
+
+void IRGenerator::CountBlock(llvm::BasicBlock *bb) {
+   if ( bb == NULL || IsSPMD() )
+     return;
+   if ( GetOptionForKey("profile-generate") != NULL || GetOptionForKey("profile-use") != NULL )
+     countedBlocks.push_back(bb);
+}
+
+// One counter per counted block, bumped atomically at the top of the
+// block so the --bench workers can share the array
+void IRGenerator::EmitBlockCounters() {
+   if ( countedBlocks.empty() )
+     return;
+
+   llvm::Type *countTy = llvm::Type::getInt64Ty(*context);
+   llvm::ArrayType *arrTy = llvm::ArrayType::get(countTy, countedBlocks.size());
+   llvm::GlobalVariable *counters =
+       new llvm::GlobalVariable(*module, arrTy, false, llvm::GlobalValue::ExternalLinkage,
+                                llvm::ConstantAggregateZero::get(arrTy),
+                                std::string(ProfileCounterPrefix) + currentFunc->getName().str());
+
+   for ( size_t k = 0; k < countedBlocks.size(); k++ ) {
+     llvm::Constant *index[] = { llvm::ConstantInt::get(countTy, 0),
+                                 llvm::ConstantInt::get(countTy, k) };
+     llvm::Constant *ptr = llvm::ConstantExpr::getInBoundsGetElementPtr(arrTy, counters, index);
+     new llvm::AtomicRMWInst(llvm::AtomicRMWInst::Add, ptr, llvm::ConstantInt::get(countTy, 1),
+                             llvm::AtomicOrdering::Monotonic, llvm::CrossThread,
+                             &*countedBlocks[k]->getFirstInsertionPt());
+   }
+}
+
+// A block that was not counted runs as often as its only predecessor if
+// that one always branches to it
+bool IRGenerator::GetBlockCount(llvm::BasicBlock *bb, uint64_t &count, int depth) {
+   for ( size_t k = 0; k < countedBlocks.size(); k++ )
+     if ( countedBlocks[k] == bb ) {
+       count = profileCounts[k];
+       return true;
+     }
+
+   llvm::BasicBlock *pred = bb->getSinglePredecessor();
+   if ( pred == NULL || depth > 8 || pred->getTerminator()->getNumSuccessors() != 1 )
+     return false;
+   return GetBlockCount(pred, count, depth + 1);
+}
+
+// The edge count is the count of to less what its other predecessors
+// contribute, which is known for those that always branch to it
+bool IRGenerator::GetEdgeCount(llvm::BasicBlock *from, llvm::BasicBlock *to, uint64_t &count) {
+   if ( !GetBlockCount(to, count, 0) )
+     return false;
+
+   for ( llvm::pred_iterator p = llvm::pred_begin(to); p != llvm::pred_end(to); p++ ) {
+     uint64_t other;
+     if ( *p == from )
+       continue;
+     if ( (*p)->getTerminator()->getNumSuccessors() != 1 || !GetBlockCount(*p, other, 0) )
+       return false;
+     count -= std::min(count, other);
+   }
+   return true;
+}
+
+void IRGenerator::ApplyProfile() {
+   const std::vector<uint64_t> *counts = GetProfileCounts(currentFunc->getName().str());
+   if ( counts == NULL || counts->size() != countedBlocks.size() ) {
+     PrintDebug("profile", "%s: %s\n", currentFunc->getName().str().c_str(),
+                counts == NULL ? "not in the profile" : "profile does not match");
+     return;
+   }
+   profileCounts = *counts;
+   currentFunc->setEntryCount(profileCounts[0]);
+
+   llvm::MDBuilder md(*context);
+   for ( llvm::Function::iterator bb = currentFunc->begin(); bb != currentFunc->end(); bb++ ) {
+     llvm::TerminatorInst *term = bb->getTerminator();
+     unsigned n = term->getNumSuccessors();
+     if ( n < 2 )
+       continue;
+
+     // One unknown edge (e.g. to a join block) is what the block's count
+     // leaves over after the others
+     std::vector<uint64_t> edges(n);
+     uint64_t total = 0, rest = 0;
+     int missing = 0, unknown = 0;
+     for ( unsigned i = 0; i < n; i++ ) {
+       if ( GetEdgeCount(&*bb, term->getSuccessor(i), edges[i]) )
+         rest += edges[i];
+       else {
+         missing++;
+         unknown = i;
+       }
+     }
+     if ( missing == 1 && GetBlockCount(&*bb, total, 0) ) {
+       edges[unknown] = total - std::min(total, rest);
+       missing = 0;
+     }
+     if ( missing > 0 )
+       continue;
+
+     // Weights are 32-bit; only their ratio matters
+     uint64_t max = *std::max_element(edges.begin(), edges.end());
+     int shift = 0;
+     while ( (max >> shift) > UINT32_MAX )
+       shift++;
+
+     std::vector<uint32_t> weights;
+     for ( unsigned i = 0; i < n; i++ )
+       weights.push_back(edges[i] >> shift);
+     term->setMetadata(llvm::LLVMContext::MD_prof, md.createBranchWeights(weights));
+   }
+   PrintDebug("profile", "%s: entry count %llu\n", currentFunc->getName().str().c_str(),
+              (unsigned long long) profileCounts[0]);
+}
+
+// The attributes let the code generator (and the JIT) use every unit the
+// CPU has, e.g. 256-bit AVX2 or 512-bit AVX-512 registers for vec4 math
+// and for the loop vectorizer's wider vectors.
+void IRGenerator::AddTargetAttributes(llvm::Function *func) {
+   if ( targetMachine == NULL )
+     return;
+
+   func->addFnAttr("target-cpu", targetMachine->getTargetCPU());
+   if ( !targetMachine->getTargetFeatureString().empty() )
+     func->addFnAttr("target-features", targetMachine->getTargetFeatureString());
+}
+
 void IRGenerator::SetFunction(llvm::Function *func) {
    currentFunc = func;
+   trapBlock = NULL;
+   countedBlocks.clear();
+   loadCache.clear();
+   uniformLoads.clear();
+   unstampedBlocks.clear();
+   stampedUpTo.clear();
 }
 
 llvm::Function *IRGenerator::GetFunction() const {
@@ -41,6 +315,10 @@ llvm::Function *IRGenerator::GetFunction() const {
 }
 
 void IRGenerator::SetBasicBlock(llvm::BasicBlock *bb) {
+   if ( bb != currentBB )
+     loadCache.clear();
+   if ( dibuilder != NULL && currentBB != NULL )
+     unstampedBlocks.insert(currentBB);
    currentBB = bb;
 }
 
@@ -48,19 +326,633 @@ llvm::BasicBlock *IRGenerator::GetBasicBlock() const {
    return currentBB;
 }
 
-llvm::Type *IRGenerator::GetIntType() const {
+IRGenerator::FoldingBuilder &IRGenerator::Builder() {
+   return BuilderAt(currentBB);
+}
+
+// With no block (global initializers) only constants can be built
+IRGenerator::FoldingBuilder &IRGenerator::BuilderAt(llvm::BasicBlock *bb) {
+   if ( bb != NULL )
+     builder->SetInsertPoint(bb);
+   else
+     builder->ClearInsertionPoint();
+   return *builder;
+}
+
+llvm::LoadInst *IRGenerator::LoadVariable(llvm::Value *ptr, const char *name) {
+   std::map<llvm::Value*, llvm::LoadInst*>::iterator it = loadCache.find(ptr);
+   if ( it != loadCache.end() )
+     return it->second;
+
+   llvm::LoadInst *load = Builder().CreateLoad(ptr, name);
+   loadCache[ptr] = load;
+   return load;
+}
+
+// Placed after the allocas, ahead of everything that could read it
+llvm::LoadInst *IRGenerator::LoadUniform(llvm::Value *ptr, const char *name) {
+   std::map<llvm::Value*, llvm::LoadInst*>::iterator cached = uniformLoads.find(ptr);
+   if ( cached != uniformLoads.end() )
+     return cached->second;
+
+   llvm::BasicBlock &entry = currentFunc->getEntryBlock();
+   llvm::BasicBlock::iterator it = entry.begin();
+   while ( it != entry.end() && llvm::isa<llvm::AllocaInst>(&*it) )
+     it++;
+
+   llvm::LoadInst *load;
+   if ( it == entry.end() )
+     load = new llvm::LoadInst(ptr, name, &entry);
+   else
+     load = new llvm::LoadInst(ptr, name, &*it);
+   load->setDebugLoc(builder->getCurrentDebugLocation());
+   uniformLoads[ptr] = load;
+   return load;
+}
+
+// Variables are allocas and globals, which never overlap; a store through
+// an element GEP drops the whole array
+void IRGenerator::InvalidateLoads(llvm::Value *ptr) {
+   while ( ptr != NULL && llvm::isa<llvm::GEPOperator>(ptr) )
+     ptr = llvm::cast<llvm::GEPOperator>(ptr)->getPointerOperand();
+
+   if ( ptr != NULL && (llvm::isa<llvm::AllocaInst>(ptr) || llvm::isa<llvm::GlobalVariable>(ptr)) )
+     loadCache.erase(ptr);
+   else
+     loadCache.clear();
+}
+
+// Allocas are grouped at the top of the entry block, ahead of the stores
+// that spill the formals, so a local declared inside a loop body does not
+// grow the stack on every iteration.
+llvm::AllocaInst *IRGenerator::CreateEntryBlockAlloca(llvm::Type *ty, const char *name) {
+   llvm::BasicBlock &entry = currentFunc->getEntryBlock();
+   llvm::BasicBlock::iterator it = entry.begin();
+
+   while ( it != entry.end() && llvm::isa<llvm::AllocaInst>(&*it) )
+     it++;
+
+   llvm::AllocaInst *alloca;
+   if ( it == entry.end() )
+     alloca = new llvm::AllocaInst(ty, name, &entry);
+   else
+     alloca = new llvm::AllocaInst(ty, name, &*it);
+   alloca->setDebugLoc(builder->getCurrentDebugLocation());
+   return alloca;
+}
+
+// Blocks left open by the statement emitters (e.g. the footer of an if
+// whose branches both return) have no terminator, which the verifier and
+// every pass that walks the CFG reject.
+void IRGenerator::TerminateOpenBlocks(llvm::Function *func) {
+   for ( llvm::Function::iterator bb = func->begin(); bb != func->end(); bb++ ) {
+     if ( bb->getTerminator() != NULL )
+       continue;
+
+     if ( func->getReturnType()->isVoidTy() )
+       llvm::ReturnInst::Create(*context, &*bb);
+     else
+       new llvm::UnreachableInst(*context, &*bb);
+   }
+}
+
+// Promote the entry block allocas to SSA values before the module is
+// written, so loops operate on registers instead of stack slots.
+void IRGenerator::PromoteToRegisters() {
+   llvm::legacy::FunctionPassManager fpm(module);
+   fpm.add(llvm::createSROAPass());
+   fpm.add(llvm::createPromoteMemoryToRegisterPass());
+   fpm.doInitialization();
+
+   for ( llvm::Module::iterator f = module->begin(); f != module->end(); f++ ) {
+     if ( !f->isDeclaration() )
+       fpm.run(*f);
+   }
+   fpm.doFinalization();
+}
+
+// Level 1 is LLVM's function simplification pipeline; levels 2 and 3 add
+// GVN, unrolling and the loop and SLP vectorizers. No level includes
+// LLVM's inliner, InlineFunctions runs before. Level 0 leaves the module
+// as emitted.
+static void ConfigurePipeline(llvm::PassManagerBuilder &builder, int level) {
+   builder.OptLevel = level;
+   builder.SizeLevel = 0;
+   builder.LoopVectorize = (level > 1);
+   builder.SLPVectorize = (level > 1);
+}
+
+void IRGenerator::Optimize(int level) {
+   if ( level <= 0 )
+     return;
+
+   // -ftime-report: LLVM times each pass and PrintTimeReport prints them
+   if ( TimeReportEnabled() )
+     llvm::TimePassesIsEnabled = true;
+
+   StartPhase("function passes");
+   OptimizeFunctions(level);
+   EndPhase();
+
+   StartPhase("module passes");
+   OptimizeModule(level);
+   EndPhase();
+}
+
+void IRGenerator::OptimizeFunctions(int level) {
+   if ( level <= 0 )
+     return;
+
+   llvm::PassManagerBuilder builder;
+   ConfigurePipeline(builder, level);
+
+   // Without the target's cost model the vectorizers assume no vector
+   // registers at all and leave every loop scalar
+   llvm::legacy::FunctionPassManager fpm(module);
+   if ( targetMachine != NULL )
+     fpm.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+   builder.populateFunctionPassManager(fpm);
+
+   fpm.doInitialization();
+   for ( llvm::Module::iterator f = module->begin(); f != module->end(); f++ ) {
+     if ( !f->isDeclaration() )
+       fpm.run(*f);
+   }
+   fpm.doFinalization();
+}
+
+void IRGenerator::OptimizeModule(int level) {
+   if ( level <= 0 )
+     return;
+
+   llvm::PassManagerBuilder builder;
+   ConfigurePipeline(builder, level);
+   if ( level > 1 )
+     builder.Inliner = llvm::createFunctionInliningPass(level, 0);
+
+   llvm::legacy::PassManager mpm;
+   if ( targetMachine != NULL )
+     mpm.add(llvm::createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+   builder.populateModulePassManager(mpm);
+
+   mpm.run(*module);
+}
+
+// SPMD kernels are the entry points of an -spmd module and call every
+// function, so it is left alone
+void IRGenerator::InternalizeHelpers() {
+   llvm::Function *main = module->getFunction("main");
+   if ( main == NULL || main->isDeclaration() || IsSPMD() )
+     return;
+
+   for ( llvm::Module::iterator f = module->begin(); f != module->end(); f++ ) {
+     if ( &*f == main || f->isDeclaration() || f->isIntrinsic() )
+       continue;
+
+     f->setLinkage(llvm::GlobalValue::InternalLinkage);
+     f->setCallingConv(llvm::CallingConv::Fast);
+     for ( llvm::Value::user_iterator u = f->user_begin(); u != f->user_end(); u++ )
+       if ( llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(*u) )
+         call->setCallingConv(llvm::CallingConv::Fast);
+   }
+}
+
+// Inline a call if the callee adds at most InlineSizeLimit instructions
+static const int InlineSizeLimit = 25;
+static const int LastCallBonus = 15;
+static const int MaxInlineRounds = 4;
+
+// Size of a call to func once inlined, in instructions; the call and the
+// return go away, and so does func itself if this is its last call
+static int InlineCost(llvm::Function *func) {
+   int cost = -2;
+   for ( llvm::Function::iterator bb = func->begin(); bb != func->end(); bb++ )
+     cost += bb->size();
+   if ( func->hasLocalLinkage() && func->hasOneUse() )
+     cost -= LastCallBonus;
+   return cost;
+}
+
+// A switch's jump table holds the addresses of the callee's own blocks, so
+// an inlined copy would jump back into the callee
+static bool HasJumpTable(llvm::Function *func) {
+   for ( llvm::Function::iterator bb = func->begin(); bb != func->end(); bb++ )
+     if ( bb->hasAddressTaken() )
+       return true;
+   return false;
+}
+
+static bool ShouldInline(llvm::CallInst *call, int level) {
+   llvm::Function *callee = call->getCalledFunction();
+   llvm::Function *caller = call->getParent()->getParent();
+   if ( callee == NULL || callee->isDeclaration() || callee == caller )
+     return false;
+   if ( HasJumpTable(callee) )
+     return false;
+   if ( callee->hasFnAttribute(llvm::Attribute::NoInline) )
+     return false;
+   if ( callee->hasFnAttribute(llvm::Attribute::AlwaysInline) )
+     return true;
+   return level <= 1 && InlineCost(callee) <= InlineSizeLimit;
+}
+
+// Inlining into a function can make it small enough to be inlined in turn,
+// so this repeats a few rounds; a recursive cycle stops at the last one
+void IRGenerator::InlineFunctions(int level) {
+   for ( int round = 0; round < MaxInlineRounds; round++ ) {
+     std::vector<llvm::CallInst*> calls;
+     for ( llvm::Module::iterator f = module->begin(); f != module->end(); f++ )
+       for ( llvm::Function::iterator bb = f->begin(); bb != f->end(); bb++ )
+         for ( llvm::BasicBlock::iterator i = bb->begin(); i != bb->end(); i++ )
+           if ( llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(&*i) )
+             if ( ShouldInline(call, level) )
+               calls.push_back(call);
+     if ( calls.empty() )
+       break;
+
+     // Callees are erased only after the round, calls in them may be listed
+     std::vector<llvm::Function*> callees;
+     for ( size_t k = 0; k < calls.size(); k++ ) {
+       llvm::Function *callee = calls[k]->getCalledFunction();
+       PrintDebug("inline", "%s into %s\n", callee->getName().str().c_str(),
+                  calls[k]->getParent()->getParent()->getName().str().c_str());
+
+       llvm::InlineFunctionInfo info;
+       llvm::InlineFunction(calls[k], info);
+       if ( std::find(callees.begin(), callees.end(), callee) == callees.end() )
+         callees.push_back(callee);
+     }
+
+     for ( size_t k = 0; k < callees.size(); k++ )
+       if ( callees[k]->hasLocalLinkage() && callees[k]->use_empty() )
+         callees[k]->eraseFromParent();
+   }
+}
+
+// What a function does to memory other than its own stack frame
+enum MemoryEffect { NoMemory, ReadsMemory, WritesMemory };
+
+// Locals and constant globals are not visible to the caller; anything not
+// known to be a global (e.g. a kernel's argument arrays) may alias any
+static MemoryEffect AccessEffect(llvm::Value *ptr, bool write) {
+   while ( llvm::GEPOperator *gep = llvm::dyn_cast<llvm::GEPOperator>(ptr) )
+     ptr = gep->getPointerOperand();
+   ptr = ptr->stripPointerCasts();
+
+   if ( llvm::isa<llvm::AllocaInst>(ptr) )
+     return NoMemory;
+   llvm::GlobalVariable *gv = llvm::dyn_cast<llvm::GlobalVariable>(ptr);
+   if ( gv == NULL )
+     return WritesMemory;
+   if ( gv->isConstant() && !write )
+     return NoMemory;
+   return write ? WritesMemory : ReadsMemory;
+}
+
+static MemoryEffect InstEffect(llvm::Instruction *inst,
+                               std::map<llvm::Function*, MemoryEffect> &effects) {
+   if ( llvm::LoadInst *load = llvm::dyn_cast<llvm::LoadInst>(inst) )
+     return load->isVolatile() ? WritesMemory : AccessEffect(load->getPointerOperand(), false);
+   if ( llvm::StoreInst *store = llvm::dyn_cast<llvm::StoreInst>(inst) )
+     return AccessEffect(store->getPointerOperand(), true);
+   if ( llvm::AtomicRMWInst *rmw = llvm::dyn_cast<llvm::AtomicRMWInst>(inst) )
+     return AccessEffect(rmw->getPointerOperand(), true);
+
+   if ( llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(inst) ) {
+     llvm::Function *callee = call->getCalledFunction();
+     if ( callee != NULL && effects.count(callee) )
+       return effects[callee];
+     if ( call->doesNotAccessMemory() )
+       return NoMemory;
+     return call->onlyReadsMemory() ? ReadsMemory : WritesMemory;
+   }
+
+   return inst->mayReadOrWriteMemory() ? WritesMemory : NoMemory;
+}
+
+// Every defined function starts out as readnone and is raised to what its
+// body and callees do until nothing changes, so recursion settles too
+void IRGenerator::InferMemoryEffects() {
+   std::map<llvm::Function*, MemoryEffect> effects;
+   for ( llvm::Module::iterator f = module->begin(); f != module->end(); f++ )
+     if ( !f->isDeclaration() )
+       effects[&*f] = NoMemory;
+
+   bool changed = true;
+   while ( changed ) {
+     changed = false;
+     for ( llvm::Module::iterator f = module->begin(); f != module->end(); f++ ) {
+       if ( f->isDeclaration() || effects[&*f] == WritesMemory )
+         continue;
+
+       MemoryEffect effect = effects[&*f];
+       for ( llvm::Function::iterator bb = f->begin(); bb != f->end(); bb++ )
+         for ( llvm::BasicBlock::iterator i = bb->begin(); i != bb->end(); i++ )
+           effect = std::max(effect, InstEffect(&*i, effects));
+
+       if ( effect != effects[&*f] ) {
+         effects[&*f] = effect;
+         changed = true;
+       }
+     }
+   }
+
+   for ( llvm::Module::iterator f = module->begin(); f != module->end(); f++ ) {
+     if ( f->isDeclaration() || effects[&*f] == WritesMemory )
+       continue;
+
+     PrintDebug("purity", "%s is %s\n", f->getName().str().c_str(),
+                effects[&*f] == NoMemory ? "readnone" : "readonly");
+     if ( effects[&*f] == NoMemory )
+       f->setDoesNotAccessMemory();
+     else
+       f->setOnlyReadsMemory();
+
+     for ( llvm::Value::user_iterator u = f->user_begin(); u != f->user_end(); u++ ) {
+       llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(*u);
+       if ( call == NULL || call->getCalledFunction() != &*f )
+         continue;
+       if ( effects[&*f] == NoMemory )
+         call->setDoesNotAccessMemory();
+       else
+         call->setOnlyReadsMemory();
+     }
+   }
+}
+
+int IRGenerator::GetSwizzleIndex(char c) {
+   switch ( c ) {
+     case 'x': case 'r': case 's': return 0;
+     case 'y': case 'g': case 't': return 1;
+     case 'z': case 'b': case 'p': return 2;
+     default:                      return 3;
+   }
+}
+
+llvm::Value *IRGenerator::CreateSwizzle(llvm::Value *vec, const char *swizzle,
+                                        llvm::BasicBlock *bb) {
+   int len = strlen(swizzle);
+
+   if ( len == 1 ) {
+     llvm::Value *idx = llvm::ConstantInt::get(GetIndexType(), GetSwizzleIndex(swizzle[0]));
+     return BuilderAt(bb).CreateExtractElement(vec, idx);
+   }
+
+   std::vector<llvm::Constant*> mask;
+   for ( int i = 0; i < len; i++ )
+     mask.push_back(llvm::ConstantInt::get(GetIndexType(), GetSwizzleIndex(swizzle[i])));
+
+   llvm::Value *undef = llvm::UndefValue::get(vec->getType());
+   return BuilderAt(bb).CreateShuffleVector(vec, undef, llvm::ConstantVector::get(mask));
+}
+
+// Returns vec with the lanes named by swizzle replaced by the lanes of val.
+// A vector val narrower than vec is first widened so both shuffle operands
+// have the same type; lane j of val then lives at index n+j of the blend.
+llvm::Value *IRGenerator::CreateSwizzleBlend(llvm::Value *vec, llvm::Value *val,
+                                             const char *swizzle, llvm::BasicBlock *bb) {
+   int len = strlen(swizzle);
+   int n = vec->getType()->getVectorNumElements();
+
+   if ( len == 1 ) {
+     llvm::Value *idx = llvm::ConstantInt::get(GetIndexType(), GetSwizzleIndex(swizzle[0]));
+     return BuilderAt(bb).CreateInsertElement(vec, val, idx);
+   }
+
+   if ( len != n ) {
+     std::vector<llvm::Constant*> widen;
+     for ( int i = 0; i < n; i++ ) {
+       if ( i < len )
+         widen.push_back(llvm::ConstantInt::get(GetIndexType(), i));
+       else
+         widen.push_back(llvm::UndefValue::get(GetIndexType()));
+     }
+
+     llvm::Value *undef = llvm::UndefValue::get(val->getType());
+     val = BuilderAt(bb).CreateShuffleVector(val, undef, llvm::ConstantVector::get(widen));
+   }
+
+   std::vector<llvm::Constant*> mask;
+   for ( int i = 0; i < n; i++ )
+     mask.push_back(llvm::ConstantInt::get(GetIndexType(), i));
+   for ( int j = 0; j < len; j++ )
+     mask[GetSwizzleIndex(swizzle[j])] = llvm::ConstantInt::get(GetIndexType(), n + j);
+
+   return BuilderAt(bb).CreateShuffleVector(vec, val, llvm::ConstantVector::get(mask));
+}
+
+// The insert + zero-mask shuffle form is what the backends match to a
+// single broadcast instruction (e.g. vbroadcastss / shufps).
+llvm::Value *IRGenerator::CreateSplat(llvm::Value *scalar, llvm::Type *vecTy,
+                                      llvm::BasicBlock *bb) {
+   int n = vecTy->getVectorNumElements();
+
+   if ( llvm::Constant *c = llvm::dyn_cast<llvm::Constant>(scalar) )
+     return llvm::ConstantVector::getSplat(n, c);
+
+   llvm::Value *zero = llvm::ConstantInt::get(GetIndexType(), 0);
+   llvm::Value *undef = llvm::UndefValue::get(vecTy);
+   llvm::Value *vec = BuilderAt(bb).CreateInsertElement(undef, scalar, zero);
+
+   llvm::Type *maskTy = llvm::VectorType::get(GetIndexType(), n);
+   llvm::Constant *mask = llvm::ConstantAggregateZero::get(maskTy);
+   return BuilderAt(bb).CreateShuffleVector(vec, undef, mask);
+}
+
+llvm::Value *IRGenerator::GetMask() {
+   llvm::Value *mask = maskStack.back();
+
+   for ( size_t i = 0; i < killSlots.size(); i++ ) {
+     llvm::Value *live = new llvm::LoadInst(killSlots[i], "", currentBB);
+     mask = llvm::BinaryOperator::CreateAnd(mask, live, "", currentBB);
+   }
+   return mask;
+}
+
+void IRGenerator::PushMask(llvm::Value *mask) {
+   maskStack.push_back(mask);
+}
+
+void IRGenerator::PopMask() {
+   maskStack.pop_back();
+}
+
+void IRGenerator::PushKillSlot(llvm::Value *slot) {
+   killSlots.push_back(slot);
+}
+
+void IRGenerator::PopKillSlot() {
+   killSlots.pop_back();
+}
+
+// The lanes running the return/break/continue leave slot; every later
+// GetMask() sees them cleared until slot is popped.
+void IRGenerator::KillLanes(llvm::Value *slot) {
+   llvm::Value *dead = llvm::BinaryOperator::CreateNot(GetMask(), "", currentBB);
+   llvm::Value *live = new llvm::LoadInst(slot, "", currentBB);
+   live = llvm::BinaryOperator::CreateAnd(live, dead, "", currentBB);
+   new llvm::StoreInst(live, slot, currentBB);
+}
+
+// <N x i1> -> iN, so "any lane set" is a single compare against zero
+llvm::Value *IRGenerator::AnyLane(llvm::Value *mask, llvm::BasicBlock *bb) {
+   llvm::Type *bitsTy = llvm::IntegerType::get(*context, laneCount);
+   llvm::Value *bits = new llvm::BitCastInst(mask, bitsTy, "", bb);
+   return new llvm::ICmpInst(*bb, llvm::CmpInst::ICMP_NE, bits,
+                             llvm::ConstantInt::get(bitsTy, 0));
+}
+
+llvm::StoreInst *IRGenerator::CreateStore(llvm::Value *val, llvm::Value *ptr,
+                                          llvm::BasicBlock *bb) {
+   InvalidateLoads(ptr);
+   if ( IsSPMD() ) {
+     llvm::Value *old = new llvm::LoadInst(ptr, "", bb);
+     val = llvm::SelectInst::Create(GetMask(), val, old, "", bb);
+   }
+   return new llvm::StoreInst(val, ptr, bb);
+}
+
+// The checks of a function share one trap block, weighted as never taken
+// so the check costs a compare and a fall-through branch.
+llvm::BranchInst *IRGenerator::CreateBoundsCheck(llvm::Value *idx, int count) {
+   if ( trapBlock == NULL ) {
+     trapBlock = llvm::BasicBlock::Create(*context, "BNDtrap", currentFunc);
+     llvm::Function *trap = llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::trap);
+     llvm::CallInst::Create(trap, "", trapBlock);
+     new llvm::UnreachableInst(*context, trapBlock);
+   }
+
+   llvm::BasicBlock *okBlk = llvm::BasicBlock::Create(*context, "BNDok", currentFunc,
+                                                      currentBB->getNextNode());
+   llvm::Value *limit = llvm::ConstantInt::get(idx->getType(), count);
+   llvm::MDBuilder weights(*context);
+
+   FoldingBuilder &b = Builder();
+   llvm::Value *inBounds = b.CreateICmpULT(idx, limit, "inbounds");
+   llvm::BranchInst *check = b.CreateCondBr(inBounds, okBlk, trapBlock,
+                                            weights.createBranchWeights(1 << 20, 1));
+   SetBasicBlock(okBlk);
+   return check;
+}
+
+void IRGenerator::RemoveBoundsCheck(llvm::BranchInst *check) {
+   llvm::Instruction *inBounds = llvm::cast<llvm::Instruction>(check->getCondition());
+   llvm::BranchInst::Create(check->getSuccessor(0), check);
+   check->eraseFromParent();
+   inBounds->eraseFromParent();
+
+   if ( trapBlock != NULL && trapBlock->hasNUses(0) ) {
+     trapBlock->eraseFromParent();
+     trapBlock = NULL;
+   }
+}
+
+// Inactive lanes still execute the divide, so give them a divisor of one
+// rather than whatever (possibly zero) value they happen to hold.
+llvm::Value *IRGenerator::GuardDivisor(llvm::Value *rhs, llvm::BasicBlock *bb) {
+   if ( !IsSPMD() )
+     return rhs;
+
+   llvm::Value *one = llvm::ConstantInt::get(rhs->getType(), 1);
+   llvm::Value *mask = GetMask();
+   return BuilderAt(bb).CreateSelect(mask, rhs, one);
+}
+
+// The loop steps i by N; lanes i+k >= count are masked off, so the last,
+// partial batch neither reads nor writes past the end of the arrays.
+llvm::Function *IRGenerator::CreateSPMDKernel(llvm::Function *func) {
+   llvm::FunctionType *fty = func->getFunctionType();
+   llvm::Type *i32 = GetIndexType();
+   std::vector<llvm::Type*> params;
+
+   params.push_back(i32);
+   for ( unsigned i = 1; i < fty->getNumParams(); i++ ) {
+     llvm::Type *elem = fty->getParamType(i)->getScalarType();
+     if ( elem->isIntegerTy(1) )
+       return NULL;
+     params.push_back(llvm::PointerType::getUnqual(elem));
+   }
+
+   llvm::Type *retTy = fty->getReturnType();
+   if ( !retTy->isVoidTy() ) {
+     if ( retTy->getScalarType()->isIntegerTy(1) )
+       return NULL;
+     params.push_back(llvm::PointerType::getUnqual(retTy->getScalarType()));
+   }
+
+   llvm::FunctionType *kty = llvm::FunctionType::get(llvm::Type::getVoidTy(*context), params, false);
+   llvm::Function *kernel = llvm::Function::Create(kty, llvm::GlobalValue::ExternalLinkage,
+                                                   func->getName() + "_kernel", module);
+   AddTargetAttributes(kernel);
+
+   llvm::BasicBlock *entry = llvm::BasicBlock::Create(*context, "entry", kernel);
+   llvm::BasicBlock *head = llvm::BasicBlock::Create(*context, "KERNhead", kernel);
+   llvm::BasicBlock *body = llvm::BasicBlock::Create(*context, "KERNbody", kernel);
+   llvm::BasicBlock *foot = llvm::BasicBlock::Create(*context, "KERNfooter", kernel);
+
+   llvm::IRBuilder<> b(entry);
+   b.CreateBr(head);
+
+   b.SetInsertPoint(head);
+   llvm::Function::arg_iterator arg = kernel->arg_begin();
+   llvm::Value *count = &*arg++;
+   llvm::PHINode *i = b.CreatePHI(i32, 2, "i");
+   i->addIncoming(b.getInt32(0), entry);
+   b.CreateCondBr(b.CreateICmpSLT(i, count), body, foot);
+
+   b.SetInsertPoint(body);
+   std::vector<llvm::Constant*> laneIds;
+   for ( int l = 0; l < laneCount; l++ )
+     laneIds.push_back(b.getInt32(l));
+   llvm::Value *lanes = b.CreateAdd(b.CreateVectorSplat(laneCount, i), llvm::ConstantVector::get(laneIds));
+   llvm::Value *mask = b.CreateICmpSLT(lanes, b.CreateVectorSplat(laneCount, count));
+
+   std::vector<llvm::Value*> args;
+   args.push_back(mask);
+   for ( unsigned p = 1; p < fty->getNumParams(); p++, arg++ ) {
+     llvm::Type *vecTy = fty->getParamType(p);
+     llvm::Value *ptr = b.CreateBitCast(b.CreateGEP(&*arg, i), llvm::PointerType::getUnqual(vecTy));
+     args.push_back(b.CreateMaskedLoad(ptr, 4, mask));
+   }
+
+   llvm::Value *ret = b.CreateCall(func, args);
+   if ( !retTy->isVoidTy() ) {
+     llvm::Value *ptr = b.CreateBitCast(b.CreateGEP(&*arg, i), llvm::PointerType::getUnqual(retTy));
+     b.CreateMaskedStore(ret, ptr, 4, mask);
+   }
+
+   i->addIncoming(b.CreateAdd(i, b.getInt32(laneCount)), body);
+   b.CreateBr(head);
+
+   b.SetInsertPoint(foot);
+   b.CreateRetVoid();
+   return kernel;
+}
+
+llvm::Type *IRGenerator::Varying(llvm::Type *ty) const {
+   if ( IsSPMD() )
+     return llvm::VectorType::get(ty, laneCount);
+   return ty;
+}
+
+llvm::Type *IRGenerator::GetIndexType() const {
    llvm::Type *ty = llvm::Type::getInt32Ty(*context);
    return ty;
 }
 
+llvm::Type *IRGenerator::GetIntType() const {
+   llvm::Type *ty = llvm::Type::getInt32Ty(*context);
+   return Varying(ty);
+}
+
 llvm::Type *IRGenerator::GetBoolType() const {
    llvm::Type *ty = llvm::Type::getInt1Ty(*context);
-   return ty;
+   return Varying(ty);
 }
 
 llvm::Type *IRGenerator::GetFloatType() const {
    llvm::Type *ty = llvm::Type::getFloatTy(*context);
-   return ty;
+   return Varying(ty);
 }
 
 llvm::Type *IRGenerator::GetVec2Type() const {
@@ -16,13 +16,26 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/DIBuilder.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Target/TargetMachine.h"
+#include <map>
+#include <set>
 #include <stack>
+#include <vector>
 
 class IRGenerator {
   public:
     IRGenerator();
     ~IRGenerator();
 
+    // With a target machine (-march) the module takes its triple and data
+    // layout, and every function its target-cpu/target-features, from it;
+    // otherwise the fixed TargetTriple/TargetLayout below are used
+    void        SetTargetMachine(llvm::TargetMachine *tm) { targetMachine = tm; }
+    void        AddTargetAttributes(llvm::Function *func);
+
     llvm::Module   *GetOrCreateModule(const char *moduleID);
     llvm::LLVMContext *GetContext() const { return context; }
 
@@ -33,6 +46,112 @@ class IRGenerator {
     llvm::BasicBlock *GetBasicBlock() const;
     void        SetBasicBlock(llvm::BasicBlock *bb);
 
+    // The builder inserts at the end of the current basic block. With the
+    // constant folder an operation on constants (scalar or vector) yields
+    // a constant instead of an instruction, so "2*3+1" is emitted as 7
+    typedef llvm::IRBuilder<llvm::ConstantFolder> FoldingBuilder;
+    FoldingBuilder &Builder();
+
+    // -g: line tables through a DIBuilder, one compile unit per module and
+    // a subprogram per function. SetDebugLocation gives the builder the
+    // source position of the node about to be emitted and stamps the
+    // instructions emitted since the last call (by the builder or not) with
+    // the previous one; FinishFunction stamps the rest of the function.
+    bool        HasDebugInfo() const { return dibuilder != NULL; }
+    void        CreateSubprogram(llvm::Function *func, int line);
+    void        SetDebugLocation(int line, int column);
+    void        FinalizeDebugInfo();
+
+    // -g with -j: each function module brings its own compile unit; once
+    // they are linked in, every subprogram is moved to this module's unit
+    // and the others are dropped
+    void        MergeCompileUnits();
+
+    // -fprofile-generate/-fprofile-use (see profile.h): CountBlock numbers
+    // a block of the current function; FinishFunction then either adds a
+    // counter to each numbered block or annotates the function with the
+    // profile's entry count and branch weights
+    void        CountBlock(llvm::BasicBlock *bb);
+    void        FinishFunction();
+
+    // Variables are loaded through a cache local to the current block: a
+    // second read of the same alloca or global returns the first load
+    // (still a LoadInst, so its address serves lvalues as before). A store
+    // drops the entry of the variable it writes, a call (NULL) and leaving
+    // the block drop them all.
+    llvm::LoadInst *LoadVariable(llvm::Value *ptr, const char *name);
+    void        InvalidateLoads(llvm::Value *ptr);
+
+    // A uniform is set by the host between invocations and never written
+    // by the shader, so each function loads it once, at the top of its
+    // entry block, and every read in the function uses that load
+    llvm::LoadInst *LoadUniform(llvm::Value *ptr, const char *name);
+
+    // Locals are always allocated in the entry block of the current
+    // function so mem2reg/SROA can promote them to SSA registers
+    llvm::AllocaInst *CreateEntryBlockAlloca(llvm::Type *ty, const char *name);
+    void        TerminateOpenBlocks(llvm::Function *func);
+    void        PromoteToRegisters();
+
+    // Run the standard -O<level> pipeline over the whole module: the
+    // per-function half, then the module half (inlining, IPO)
+    void        Optimize(int level);
+
+    // A program with a main has no other entry point: every other function
+    // becomes an internal fastcc helper. At -O0/-O1, where the pass
+    // pipeline has no inliner, InlineFunctions inlines the calls to small
+    // functions itself; #pragma inline/noinline (alwaysinline/noinline)
+    // override the size limit at every level
+    void        InternalizeHelpers();
+    void        InlineFunctions(int level);
+
+    // Marks the functions that touch no global (readnone) or only read
+    // globals (readonly), and every call to them, so equal calls can be
+    // CSE'd and calls hoisted out of loops
+    void        InferMemoryEffects();
+
+    // Swizzle helpers: a read is a single extractelement/shufflevector,
+    // a write is a blend shuffle of the new lanes into the old vector
+    static int  GetSwizzleIndex(char c);
+    llvm::Value *CreateSwizzle(llvm::Value *vec, const char *swizzle, llvm::BasicBlock *bb);
+    llvm::Value *CreateSwizzleBlend(llvm::Value *vec, llvm::Value *val,
+                                    const char *swizzle, llvm::BasicBlock *bb);
+
+    // Broadcast a scalar to every lane of vecTy: a constant vector for a
+    // constant scalar, otherwise insertelement + zero-mask shufflevector
+    llvm::Value *CreateSplat(llvm::Value *scalar, llvm::Type *vecTy, llvm::BasicBlock *bb);
+
+    // SPMD mode (-spmd=N): every int/bool/float value is an N-lane vector,
+    // one lane per invocation. Control flow that depends on a varying value
+    // is replaced by an execution mask; stores only update the active lanes.
+    void        SetLaneCount(int n) { laneCount = n; }
+    int         GetLaneCount() const { return laneCount; }
+    bool        IsSPMD() const { return laneCount > 1; }
+
+    // The mask is the innermost if/else arm mask ANDed with every kill slot.
+    // A kill slot is an alloca holding the lanes still alive in a function
+    // (cleared by return), a loop (break) or a loop iteration (continue).
+    llvm::Value *GetMask();
+    void        PushMask(llvm::Value *mask);
+    void        PopMask();
+    void        PushKillSlot(llvm::Value *slot);
+    void        PopKillSlot();
+    void        KillLanes(llvm::Value *slot);
+    llvm::Value *AnyLane(llvm::Value *mask, llvm::BasicBlock *bb);
+    llvm::StoreInst *CreateStore(llvm::Value *val, llvm::Value *ptr, llvm::BasicBlock *bb);
+    llvm::Value *GuardDivisor(llvm::Value *rhs, llvm::BasicBlock *bb);
+
+    // Adds "void <name>_kernel(i32 count, T1 *a1, ..., R *out)" that runs
+    // func over count invocations, N at a time, on SoA argument arrays
+    llvm::Function *CreateSPMDKernel(llvm::Function *func);
+
+    std::vector<llvm::Value*> brkMaskStack;
+    std::vector<llvm::Value*> contMaskStack;
+    llvm::Value *retSlot;
+    llvm::Value *liveSlot;
+
+    // Index and lane-number operands are scalar i32 in every mode
+    llvm::Type *GetIndexType() const;
     llvm::Type *GetIntType() const;
     llvm::Type *GetBoolType() const;
     llvm::Type *GetFloatType() const;
@@ -40,6 +159,21 @@ class IRGenerator {
     llvm::Type *GetVec3Type() const;
     llvm::Type *GetVec4Type() const;
 
+    // -fbounds-check: "idx u< count" or a branch to the function's trap
+    // block; the code after the check goes into a new current block. A
+    // check found redundant later is turned back into a plain branch.
+    llvm::BranchInst *CreateBoundsCheck(llvm::Value *idx, int count);
+    void        RemoveBoundsCheck(llvm::BranchInst *check);
+
+    // For loops whose induction variable (the alloca slot) stays within
+    // [lo, hi] in the body, innermost last, with the checks on it
+    struct InductionVar {
+        llvm::Value *slot;
+        int lo, hi;
+        std::vector<llvm::BranchInst*> checks;
+    };
+    std::vector<InductionVar> inductionVars;
+
     std::stack<llvm::BasicBlock*>* brkStack;
     std::stack<llvm::BasicBlock*>* contStack;
     std::stack<llvm::BasicBlock*>* footStack;
@@ -47,11 +181,46 @@ class IRGenerator {
   private:
     llvm::LLVMContext *context;
     llvm::Module      *module;
+    FoldingBuilder    *builder;
+    llvm::TargetMachine *targetMachine;
 
     // track which function or basic block is active
     llvm::Function    *currentFunc;
     llvm::BasicBlock  *currentBB;
 
+    llvm::BasicBlock  *trapBlock;
+
+    llvm::DIBuilder   *dibuilder;
+    llvm::DIFile      *debugFile;
+    llvm::DICompileUnit *compileUnit;
+
+    std::set<llvm::BasicBlock*> unstampedBlocks;
+    std::map<llvm::BasicBlock*, llvm::WeakVH> stampedUpTo;
+
+    void        StampDebugLocation();
+    void        StampFunction();
+
+    void        OptimizeFunctions(int level);
+    void        OptimizeModule(int level);
+
+    std::map<llvm::Value*, llvm::LoadInst*> loadCache;
+    std::map<llvm::Value*, llvm::LoadInst*> uniformLoads;
+
+    std::vector<llvm::BasicBlock*> countedBlocks;
+    std::vector<uint64_t> profileCounts;
+
+    void        EmitBlockCounters();
+    void        ApplyProfile();
+    bool        GetBlockCount(llvm::BasicBlock *bb, uint64_t &count, int depth);
+    bool        GetEdgeCount(llvm::BasicBlock *from, llvm::BasicBlock *to, uint64_t &count);
+
+    int                laneCount;
+    std::vector<llvm::Value*> maskStack;
+    std::vector<llvm::Value*> killSlots;
+
+    llvm::Type *Varying(llvm::Type *ty) const;
+    FoldingBuilder &BuilderAt(llvm::BasicBlock *bb);
+
     static const char *TargetTriple;
     static const char *TargetLayout;
 };
@@ -0,0 +1,498 @@
+/* File: jit.cc
+ * ------------
+ * In-process runner for "glc --run file.dat". The module is compiled with
+ * an ORC JIT; a small wrapper function that stores the .dat globals,
+ * calls the shader with the .dat parameters and writes the result to a
+ * buffer is added to the module first, so the call itself needs no
+ * knowledge of the shader's signature.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "jit.h"
+#include "executor.h"
+#include "profile.h"
+#include "utility.h"
+
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Mangler.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
+#include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+
+using namespace std;
+
+static const char *WrapperName = "__glc_run";
+static const char *BatchName = "__glc_batch";
+
+// Invocations per executor chunk; a multiple of every -spmd lane count
+static const int Grain = 1024;
+
+// Record i adds i % RecordSpread to the .dat arguments, so neighbouring
+// records (and the lanes of one SPMD gang) see different inputs
+static const int RecordSpread = 61;
+
+
+/* Class: ShaderJIT
+ * ----------------
+ * Minimal ORC stack: IR is compiled to an object file by the compile
+ * layer and linked in memory by the object layer. Symbols are resolved
+ * against the JIT'd modules first and the host process second.
+ */
+class ShaderJIT {
+    std::unique_ptr<llvm::TargetMachine> tm;
+    const llvm::DataLayout layout;
+    llvm::orc::ObjectLinkingLayer<> objectLayer;
+    llvm::orc::IRCompileLayer<decltype(objectLayer)> compileLayer;
+
+  public:
+    ShaderJIT() :
+        tm(llvm::EngineBuilder().selectTarget()),
+        layout(tm->createDataLayout()),
+        compileLayer(objectLayer, llvm::orc::SimpleCompiler(*tm))
+    {
+        llvm::sys::DynamicLibrary::LoadLibraryPermanently(NULL);
+    }
+
+    const llvm::DataLayout &GetDataLayout() const { return layout; }
+
+    void AddModule(std::unique_ptr<llvm::Module> mod) {
+        auto resolver = llvm::orc::createLambdaResolver(
+            [&](const std::string &name) {
+                if (auto sym = compileLayer.findSymbol(name, false))
+                    return sym.toRuntimeDyldSymbol();
+                return llvm::RuntimeDyld::SymbolInfo(nullptr);
+            },
+            [](const std::string &name) {
+                if (uint64_t addr = llvm::RTDyldMemoryManager::getSymbolAddressInProcess(name))
+                    return llvm::RuntimeDyld::SymbolInfo(addr, llvm::JITSymbolFlags::Exported);
+                return llvm::RuntimeDyld::SymbolInfo(nullptr);
+            });
+
+        std::vector<std::unique_ptr<llvm::Module> > mods;
+        mods.push_back(std::move(mod));
+        compileLayer.addModuleSet(std::move(mods),
+                                  llvm::make_unique<llvm::SectionMemoryManager>(),
+                                  std::move(resolver));
+    }
+
+    void *GetSymbolAddress(const char *name) {
+        std::string mangled;
+        llvm::raw_string_ostream stream(mangled);
+        llvm::Mangler::getNameWithPrefix(stream, name, layout);
+        llvm::orc::JITSymbol sym = compileLayer.findSymbol(stream.str(), true);
+        return sym ? (void *)sym.getAddress() : NULL;
+    }
+};
+
+
+/* Splits "key: a, b, c" into key and the comma separated, trimmed values.
+ * Returns false for blank lines.
+ */
+static bool ParseDatLine(char *line, string &key, vector<string> &vals) {
+    char *colon = strchr(line, ':');
+    if (colon == NULL)
+        return false;
+
+    *colon = '\0';
+    key = strtok(line, " \t");
+
+    for (char *tok = strtok(colon+1, ",\r\n"); tok != NULL; tok = strtok(NULL, ",\r\n")) {
+        while (*tok == ' ' || *tok == '\t') tok++;
+        int len = strlen(tok);
+        while (len > 0 && (tok[len-1] == ' ' || tok[len-1] == '\t')) tok[--len] = '\0';
+        vals.push_back(tok);
+    }
+    return true;
+}
+
+/* Builds the constant for "<type>, v1, v2, ..." starting at vals[first]. */
+static llvm::Constant *MakeConstant(llvm::LLVMContext &con, vector<string> &vals, int first) {
+    const string &type = vals[first];
+    llvm::Type *floatTy = llvm::Type::getFloatTy(con);
+
+    if (type == "int")
+        return llvm::ConstantInt::get(llvm::Type::getInt32Ty(con), atoi(vals[first+1].c_str()));
+    if (type == "bool")
+        return llvm::ConstantInt::get(llvm::Type::getInt1Ty(con),
+                                      vals[first+1] == "true" || vals[first+1] == "1");
+    if (type == "float")
+        return llvm::ConstantFP::get(floatTy, atof(vals[first+1].c_str()));
+
+    if (type == "vec2" || type == "vec3" || type == "vec4") {
+        vector<llvm::Constant*> elems;
+        for (int i = 0; i < type[3] - '0'; i++)
+            elems.push_back(llvm::ConstantFP::get(floatTy, atof(vals[first+1+i].c_str())));
+        return llvm::ConstantVector::get(elems);
+    }
+
+    Failure("Unsupported type in .dat file: %s", type.c_str());
+    return NULL;
+}
+
+/* With -spmd every value is one lane per invocation; the .dat values are
+ * broadcast so all lanes run the same invocation.
+ */
+static llvm::Constant *Broadcast(llvm::Constant *c, int lanes) {
+    return lanes > 1 ? llvm::ConstantVector::getSplat(lanes, c) : c;
+}
+
+/* Adds "void __glc_run(i8 *out)" that sets the globals, calls the shader
+ * and stores its return value to out. An SPMD shader is called with every
+ * lane enabled and lane 0 of its result is stored.
+ */
+static llvm::Function *BuildWrapper(llvm::Module *mod, const char *datFile,
+                                    llvm::Type *&retType, vector<vector<string> > &params) {
+    llvm::LLVMContext &con = mod->getContext();
+    FILE *fp = fopen(datFile, "r");
+    if (fp == NULL)
+        Failure("Cannot open %s", datFile);
+
+    llvm::Type *bytePtr = llvm::Type::getInt8PtrTy(con);
+    llvm::FunctionType *wrapTy = llvm::FunctionType::get(llvm::Type::getVoidTy(con), bytePtr, false);
+    llvm::Function *wrapper = llvm::Function::Create(wrapTy, llvm::GlobalValue::ExternalLinkage,
+                                                     WrapperName, mod);
+    llvm::BasicBlock *bb = llvm::BasicBlock::Create(con, "entry", wrapper);
+
+    llvm::Function *func = NULL;
+    vector<llvm::Value*> args;
+    char line[1024];
+    int lanes = GetOptionForKey("spmd") ? atoi(GetOptionForKey("spmd")) : 0;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        string key;
+        vector<string> vals;
+        if (!ParseDatLine(line, key, vals) || vals.empty())
+            continue;
+
+        if (key == "funct") {
+            func = mod->getFunction(vals[0]);
+            if (func == NULL)
+                Failure("No function named %s", vals[0].c_str());
+        }
+        else if (key == "param") {
+            params.push_back(vals);
+            args.push_back(Broadcast(MakeConstant(con, vals, 0), lanes));
+        }
+        else if (key == "gin") {
+            llvm::GlobalVariable *gv = mod->getGlobalVariable(vals[0], true);
+            if (gv == NULL)
+                Failure("No global named %s", vals[0].c_str());
+            new llvm::StoreInst(Broadcast(MakeConstant(con, vals, 1), lanes), gv, bb);
+        }
+    }
+    fclose(fp);
+
+    if (func == NULL)
+        Failure("%s does not name a function", datFile);
+
+    if (lanes > 1) {
+        llvm::Type *maskTy = llvm::VectorType::get(llvm::Type::getInt1Ty(con), lanes);
+        args.insert(args.begin(), llvm::Constant::getAllOnesValue(maskTy));
+    }
+
+    // A helper of a program with a main is internal and fastcc
+    llvm::CallInst *call = llvm::CallInst::Create(func, args, "", bb);
+    call->setCallingConv(func->getCallingConv());
+    llvm::Value *ret = call;
+    retType = func->getReturnType();
+
+    if (lanes > 1 && !retType->isVoidTy()) {
+        llvm::Value *lane0 = llvm::ConstantInt::get(llvm::Type::getInt32Ty(con), 0);
+        ret = llvm::ExtractElementInst::Create(ret, lane0, "", bb);
+        retType = retType->getScalarType();
+    }
+
+    if (!retType->isVoidTy()) {
+        llvm::Value *out = new llvm::BitCastInst(&*wrapper->arg_begin(),
+                                                 llvm::PointerType::getUnqual(retType), "", bb);
+        new llvm::StoreInst(ret, out, false, 4, bb);
+    }
+    llvm::ReturnInst::Create(con, bb);
+    return func;
+}
+
+/* -fprofile-generate: the JIT runs no destructors, so the module's profile
+ * writer is called once the shader has run.
+ */
+static void WriteCounters(ShaderJIT &jit) {
+    if (GetOptionForKey("profile-generate") == NULL)
+        return;
+
+    void (*write)() = (void (*)())jit.GetSymbolAddress(ProfileWriterName);
+    if (write != NULL)
+        write();
+}
+
+static void PrintResult(llvm::Type *retType, void *buf) {
+    if (retType->isVoidTy())
+        return;
+
+    if (retType->isIntegerTy(1))
+        printf("Result: %d\n", *(unsigned char *)buf & 1);
+    else if (retType->isIntegerTy())
+        printf("Result: %d\n", *(int *)buf);
+    else if (retType->isFloatTy())
+        printf("Result: %e\n", *(float *)buf);
+    else if (retType->isVectorTy()) {
+        printf("Result:");
+        for (unsigned i = 0; i < retType->getVectorNumElements(); i++)
+            printf(" %e", ((float *)buf)[i]);
+        printf("\n");
+    }
+}
+
+void RunShader(llvm::Module *mod, const char *datFile) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+
+    llvm::Type *retType = NULL;
+    vector<vector<string> > params;
+    BuildWrapper(mod, datFile, retType, params);
+
+    ShaderJIT jit;
+    mod->setDataLayout(jit.GetDataLayout());
+    jit.AddModule(std::unique_ptr<llvm::Module>(mod));
+
+    void (*run)(void *) = (void (*)(void *))jit.GetSymbolAddress(WrapperName);
+    if (run == NULL)
+        Failure("JIT failed to compile %s", WrapperName);
+
+    double buf[4];   // large enough for a vec4
+    run(buf);
+    PrintResult(retType, buf);
+    WriteCounters(jit);
+}
+
+
+
+/* Element types of the batch arrays: one per argument, then the result.
+ * An SPMD shader reads and writes one lane per record.
+ */
+static void GetRecordTypes(llvm::Function *func, int lanes, vector<llvm::Type*> &recTys) {
+    llvm::FunctionType *fty = func->getFunctionType();
+
+    for (unsigned p = (lanes > 1 ? 1 : 0); p < fty->getNumParams(); p++)
+        recTys.push_back(lanes > 1 ? fty->getParamType(p)->getScalarType() : fty->getParamType(p));
+
+    if (!fty->getReturnType()->isVoidTy())
+        recTys.push_back(lanes > 1 ? fty->getReturnType()->getScalarType() : fty->getReturnType());
+}
+
+/* Adds "void __glc_batch(i8 **arrays, i32 begin, i32 end)" that runs the
+ * invocations [begin, end). arrays[p] is the input array of argument p,
+ * the last one the output array. A scalar shader is called once per
+ * invocation, an SPMD shader through its <name>_kernel entry.
+ */
+static void BuildBatchWrapper(llvm::Module *mod, llvm::Function *func, int lanes) {
+    llvm::LLVMContext &con = mod->getContext();
+    llvm::Type *i32 = llvm::Type::getInt32Ty(con);
+    llvm::Type *params[] = { llvm::PointerType::getUnqual(llvm::Type::getInt8PtrTy(con)), i32, i32 };
+    llvm::FunctionType *batchTy = llvm::FunctionType::get(llvm::Type::getVoidTy(con), params, false);
+    llvm::Function *batch = llvm::Function::Create(batchTy, llvm::GlobalValue::ExternalLinkage,
+                                                   BatchName, mod);
+
+    llvm::Function::arg_iterator arg = batch->arg_begin();
+    llvm::Value *arrays = &*arg++;
+    llvm::Value *begin = &*arg++;
+    llvm::Value *end = &*arg++;
+
+    llvm::BasicBlock *entry = llvm::BasicBlock::Create(con, "entry", batch);
+    llvm::IRBuilder<> b(entry);
+
+    vector<llvm::Type*> recTys;
+    vector<llvm::Value*> bases;
+    GetRecordTypes(func, lanes, recTys);
+    for (unsigned p = 0; p < recTys.size(); p++) {
+        llvm::Value *raw = b.CreateLoad(b.CreateConstGEP1_32(arrays, p));
+        bases.push_back(b.CreateBitCast(raw, llvm::PointerType::getUnqual(recTys[p])));
+    }
+
+    if (lanes > 1) {
+        string name = func->getName().str() + "_kernel";
+        llvm::Function *kernel = mod->getFunction(name);
+        if (kernel == NULL)
+            Failure("%s has no SPMD kernel", func->getName().str().c_str());
+
+        vector<llvm::Value*> args;
+        args.push_back(b.CreateSub(end, begin));
+        for (unsigned p = 0; p < bases.size(); p++)
+            args.push_back(b.CreateGEP(bases[p], begin));
+        b.CreateCall(kernel, args);
+        b.CreateRetVoid();
+        return;
+    }
+
+    llvm::BasicBlock *head = llvm::BasicBlock::Create(con, "BATCHhead", batch);
+    llvm::BasicBlock *body = llvm::BasicBlock::Create(con, "BATCHbody", batch);
+    llvm::BasicBlock *foot = llvm::BasicBlock::Create(con, "BATCHfooter", batch);
+    b.CreateBr(head);
+
+    b.SetInsertPoint(head);
+    llvm::PHINode *i = b.CreatePHI(i32, 2, "i");
+    i->addIncoming(begin, entry);
+    b.CreateCondBr(b.CreateICmpSLT(i, end), body, foot);
+
+    b.SetInsertPoint(body);
+    vector<llvm::Value*> args;
+    for (unsigned p = 0; p < func->arg_size(); p++)
+        args.push_back(b.CreateAlignedLoad(b.CreateGEP(bases[p], i), 4));
+
+    llvm::CallInst *ret = b.CreateCall(func, args);
+    ret->setCallingConv(func->getCallingConv());
+    if (!func->getReturnType()->isVoidTy())
+        b.CreateAlignedStore(ret, b.CreateGEP(bases.back(), i), 4);
+
+    i->addIncoming(b.CreateAdd(i, b.getInt32(1)), body);
+    b.CreateBr(head);
+
+    b.SetInsertPoint(foot);
+    b.CreateRetVoid();
+}
+
+/* Writes the value of "<type>, v1, v2, ..." plus offset in the layout the
+ * shader loads; an odd offset flips a bool.
+ */
+static void PackValue(vector<string> &vals, int offset, char *buf) {
+    const string &type = vals[0];
+
+    if (type == "int")
+        *(int *)buf = atoi(vals[1].c_str()) + offset;
+    else if (type == "bool")
+        *(unsigned char *)buf = (vals[1] == "true" || vals[1] == "1") ^ (offset & 1);
+    else
+        for (size_t i = 1; i < vals.size(); i++)
+            ((float *)buf)[i-1] = atof(vals[i].c_str()) + offset;
+}
+
+struct Batch {
+    void (*run)(char **arrays, int begin, int end);
+    char **arrays;
+};
+
+static void RunChunk(void *data, int begin, int end) {
+    Batch *batch = (Batch *)data;
+    batch->run(batch->arrays, begin, end);
+}
+
+void RunShaderBatch(llvm::Module *mod, const char *datFile, int invocations) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+
+    int lanes = GetOptionForKey("spmd") ? atoi(GetOptionForKey("spmd")) : 0;
+    llvm::Type *retType = NULL;
+    vector<vector<string> > params;
+    llvm::Function *func = BuildWrapper(mod, datFile, retType, params);
+    BuildBatchWrapper(mod, func, lanes);
+
+    vector<llvm::Type*> recTys;
+    GetRecordTypes(func, lanes, recTys);
+    bool hasResult = !retType->isVoidTy();
+    if (params.size() + hasResult != recTys.size())
+        Failure("%s does not give every argument of %s", datFile, func->getName().str().c_str());
+
+    ShaderJIT jit;
+    mod->setDataLayout(jit.GetDataLayout());
+
+    vector<uint64_t> strides;
+    for (size_t p = 0; p < recTys.size(); p++)
+        strides.push_back(jit.GetDataLayout().getTypeAllocSize(recTys[p]));
+    uint64_t resultSize = hasResult ? jit.GetDataLayout().getTypeStoreSize(retType) : 0;
+
+    jit.AddModule(std::unique_ptr<llvm::Module>(mod));
+
+    void (*run)(void *) = (void (*)(void *))jit.GetSymbolAddress(WrapperName);
+    Batch batch;
+    batch.run = (void (*)(char **, int, int))jit.GetSymbolAddress(BatchName);
+    if (run == NULL || batch.run == NULL)
+        Failure("JIT failed to compile %s", datFile);
+
+    // The single call sets the globals
+    double buf[4];
+    run(buf);
+    PrintResult(retType, buf);
+
+    // Every input record holds the .dat arguments offset by its index; the
+    // output arrays are allocated up front so the workers only ever write
+    // into them
+    vector<char*> arrays;
+    for (size_t p = 0; p < params.size(); p++) {
+        arrays.push_back((char *)malloc(strides[p] * invocations));
+        for (int i = 0; i < invocations; i++)
+            PackValue(params[p], i % RecordSpread, arrays[p] + strides[p] * i);
+    }
+
+    // The reference result of each record comes from running it alone:
+    // one scalar call, or the kernel with only its first lane active
+    vector<char*> refArrays(arrays);
+    if (hasResult) {
+        arrays.push_back((char *)calloc(invocations, strides.back()));
+        refArrays.push_back((char *)calloc(invocations, strides.back()));
+        for (int i = 0; i < invocations; i++)
+            batch.run(refArrays.data(), i, i + 1);
+    }
+    batch.arrays = arrays.data();
+
+    vector<int> threadCounts;
+    int maxThreads = std::thread::hardware_concurrency();
+    for (int t = 1; t < maxThreads; t *= 2)
+        threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads > 1 ? maxThreads : 1);
+
+    printf("%8s %16s %9s\n", "threads", "invocations/s", "speedup");
+    double base = 0;
+    for (size_t k = 0; k < threadCounts.size(); k++) {
+        Executor executor(threadCounts[k]);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        executor.Run(invocations, Grain, RunChunk, &batch);
+        std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+
+        double rate = invocations / secs.count();
+        if (k == 0)
+            base = rate;
+        printf("%8d %16.0f %8.2fx\n", threadCounts[k], rate, rate / base);
+    }
+
+    // Shaders that write globals race across workers and may not match
+    if (hasResult) {
+        int differ = 0;
+        uint64_t offset = 0;
+        for (int i = 0; i < invocations; i++, offset += strides.back())
+            if (memcmp(arrays.back() + offset, refArrays.back() + offset, resultSize) != 0)
+                differ++;
+        if (differ != 0)
+            printf("%d of %d results differ from running their record alone\n", differ, invocations);
+
+        // FNV-1a over the results, so a scalar and an -spmd build of the
+        // same shader can be compared record by record
+        uint64_t hash = 14695981039346656037ULL;
+        for (int i = 0; i < invocations; i++)
+            for (uint64_t k = 0; k < resultSize; k++)
+                hash = (hash ^ (unsigned char)arrays.back()[strides.back() * i + k]) * 1099511628211ULL;
+        printf("Checksum: %016llx\n", (unsigned long long)hash);
+        free(refArrays.back());
+    }
+
+    WriteCounters(jit);
+
+    for (size_t p = 0; p < arrays.size(); p++)
+        free(arrays[p]);
+}
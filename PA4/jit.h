@@ -0,0 +1,50 @@
+/**
+ * File: jit.h
+ * -----------
+ *  This file declares the in-process runner used by "glc --run file.dat".
+ *
+ *  Instead of writing bitcode and handing it to an external tool, the
+ *  module built by Program::Emit is compiled with an ORC JIT and the
+ *  function named in the .dat file is called directly. A .dat file holds
+ *  one directive per line:
+ *
+ *     funct: foo                  function to call
+ *     param: float, 11.0          next argument (type, value...)
+ *     gin: v2, vec2, 9.5, 9.0     global to set first (name, type, value...)
+ *
+ *  The return value is printed in the same "Result: ..." form as the
+ *  samples/<name>.out files.
+ */
+
+#ifndef _H_jit
+#define _H_jit
+
+#include "llvm/IR/Module.h"
+
+/**
+ * Function: RunShader()
+ * Usage: RunShader(mod, "samples/foo.dat");
+ * -----------------------------------------
+ * JIT-compiles mod, sets the globals and calls the function described by
+ * datFile, then prints its result to stdout. Takes ownership of mod.
+ */
+
+void RunShader(llvm::Module *mod, const char *datFile);
+
+/**
+ * Function: RunShaderBatch()
+ * Usage: RunShaderBatch(mod, "samples/foo.dat", 1000000);
+ * -------------------------------------------------------
+ * Like RunShader, then runs the same call as a batch of invocations on
+ * the work-stealing executor with 1, 2, 4, ... threads up to the number
+ * of cores and prints the invocations per second for each thread count.
+ * Invocation i reads the .dat arguments plus i % 61 from its own input
+ * record and writes its own output record; each record is also run
+ * alone first, and the number of batched results that differ from that
+ * is printed, followed by a checksum of all the results. Takes ownership
+ * of mod.
+ */
+
+void RunShaderBatch(llvm::Module *mod, const char *datFile, int invocations);
+
+#endif
@@ -9,22 +9,75 @@
 #include "utility.h"
 #include "errors.h"
 #include "parser.h"
+#include "timer.h"
+#include "cache.h"
+#include <string>
 
 
+/* Function: ReadInput()
+ * ---------------------
+ * Reads all of stdin, for the compile cache to hash.
+ */
+static std::string ReadInput()
+{
+    std::string text;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0)
+        text.append(buf, n);
+    return text;
+}
+
 /* Function: main()
  * ----------------
  * Entry point to the entire program.  We parse the command line and turn
  * on any debugging flags requested by the user when invoking the program.
  * InitScanner() is used to set up the scanner.
  * InitParser() is used to set up the parser. The call to yyparse() will
- * attempt to parse a complete program from the input. 
+ * attempt to parse a complete program from the input. If that succeeds
+ * without errors the program is emitted. With --cache the source is read
+ * up front and, if it was compiled before with the same options, the
+ * stored output is written instead. With -ftime-report each of these
+ * phases is timed and the report is printed at the end.
  */
 int main(int argc, char *argv[])
 {
     ParseCommandLine(argc, argv);
+    StartPhase("total");
     InitScanner();
     InitParser();
+
+    if ( CacheEnabled() ) {
+        StartPhase("cache lookup");
+        std::string source = ReadInput();
+        bool hit = CacheLookup(source.data(), source.size());
+        EndPhase();
+
+        if ( hit ) {
+            EndPhase();
+            PrintTimeReport();
+            return 0;
+        }
+        ScanFromString(source.data(), source.size());
+    }
+
+    StartPhase("parse");
     yyparse();
+    EndPhase();
+
+    // if no errors, advance to next phase
+    Program *program = GetParsedProgram();
+    if (program != NULL && ReportError::NumErrors() == 0) {
+        if ( IsDebugOn("dumpAST") ) {
+            program->Print(0);
+        }
+        StartPhase("emit");
+        program->Emit();
+        EndPhase();
+    }
+
+    EndPhase();
+    PrintTimeReport();
     return (ReportError::NumErrors() == 0? 0 : -1);
 }
 
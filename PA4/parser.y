@@ -22,6 +22,8 @@
 
 void yyerror(const char *msg); // standard error-handling routine
 
+static Program *parsedProgram = NULL;
+
 %}
 
 /* The section before the first %% is the Definitions section of the yacc
@@ -53,6 +55,7 @@ void yyerror(const char *msg); // standard error-handling routine
     List<VarDecl *> *varDeclList;
     List<Stmt*> *stmtList;
     Stmt       *stmt;
+    LoopStmt   *loopStmt;
     Operator *ops;
     Identifier *funcId;
     List<Expr*> *argList;
@@ -74,6 +77,8 @@ void yyerror(const char *msg); // standard error-handling routine
 %token   T_In T_Out T_Const T_Uniform
 %token   T_LeftParen T_RightParen T_LeftBracket T_RightBracket T_LeftBrace T_RightBrace
 %token   T_Dot T_Comma T_Colon T_Semicolon T_Question
+%token   T_PragmaNoUnroll T_PragmaInline T_PragmaNoInline
+%token   <integerConstant> T_PragmaUnroll T_PragmaVectorize
 
 %token   <identifier> T_LessEqual T_GreaterEqual T_EQ T_NE
 %token   <identifier> T_And T_Or 
@@ -119,7 +124,8 @@ void yyerror(const char *msg); // standard error-handling routine
 %type <varDeclList> ParameterList
 %type <stmt>       Statement
 %type <stmtList>   StatementList
-%type <stmt>       SingleStatement SelectionStmt SwitchStmt CaseStmt JumpStmt WhileStmt ForStmt
+%type <stmt>       SingleStatement SelectionStmt SwitchStmt CaseStmt JumpStmt
+%type <loopStmt>   IterationStmt WhileStmt ForStmt
 %type <stmt>       CompoundStatement
 %type <ops>        AssignOp
 %type <funcId>     FunctionIdentifier
@@ -137,14 +143,8 @@ Program   :    DeclList            {
                                       /* pp2: The @1 is needed to convince 
                                        * yacc to set up yylloc. You can remove 
                                        * it once you have other uses of @n*/
-                                      Program *program = new Program($1);
-                                      // if no errors, advance to next phase
-                                      if (ReportError::NumErrors() == 0) {
-                                          if ( IsDebugOn("dumpAST") ) {
-                                            program->Print(0);
-                                          }
-                                          program->Emit();
-                                      }
+                                      // main() takes it to the next phase
+                                      parsedProgram = new Program($1);
                                     }
           ;
 
@@ -162,6 +162,10 @@ DeclList  :    DeclList Decl        { ($$=$1)->Append($2); }
    
 Decl      :    Declaration                   { $$ = $1; }
           |    FuncDecl CompoundStatement    { $1->SetFunctionBody($2); $$ = $1; }
+          |    T_PragmaInline FuncDecl CompoundStatement
+                                             { $2->SetFunctionBody($3); $2->SetInlineHint(1); $$ = $2; }
+          |    T_PragmaNoInline FuncDecl CompoundStatement
+                                             { $2->SetFunctionBody($3); $2->SetInlineHint(-1); $$ = $2; }
           ;
 
 /* combine declaration and init_decl_list into a single rule
@@ -270,8 +274,7 @@ SingleStatement   : T_Semicolon      { $$ = new EmptyExpr();  }
                   | SwitchStmt       { $$ = $1; }
                   | CaseStmt         { $$ = $1; }
                   | JumpStmt         { $$ = $1; }
-                  | WhileStmt        { $$ = $1; }
-                  | ForStmt          { $$ = $1; }
+                  | IterationStmt    { $$ = $1; }
                   ;
 
 SelectionStmt     : T_If T_LeftParen Expression T_RightParen Statement T_Else Statement
@@ -299,6 +302,13 @@ JumpStmt           : T_Break   T_Semicolon    { $$ = new BreakStmt(yylloc); }
                    | T_Return Expression T_Semicolon { $$ = new ReturnStmt(yyloc, $2); }
                    ; 
 
+IterationStmt      : WhileStmt                          { $$ = $1; }
+                   | ForStmt                            { $$ = $1; }
+                   | T_PragmaUnroll IterationStmt       { ($$ = $2)->SetUnroll($1); }
+                   | T_PragmaNoUnroll IterationStmt     { ($$ = $2)->SetUnroll(1); }
+                   | T_PragmaVectorize IterationStmt    { ($$ = $2)->SetVectorize($1); }
+                   ;
+
 WhileStmt          : T_While T_LeftParen Expression T_RightParen Statement { $$ = new WhileStmt($3, $5); }
                    ;
 
@@ -502,3 +512,14 @@ void InitParser()
    PrintDebug("parser", "Initializing parser");
    yydebug = false;
 }
+
+
+/* Function: GetParsedProgram
+ * --------------------------
+ * Returns the Program built by the last call to yyparse(), or NULL if the
+ * input did not parse.
+ */
+Program *GetParsedProgram()
+{
+   return parsedProgram;
+}
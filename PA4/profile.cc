@@ -0,0 +1,135 @@
+/* File: profile.cc
+ * ----------------
+ * Implementation of the -fprofile-generate / -fprofile-use block profile.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include "profile.h"
+#include "utility.h"
+
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+const char *ProfileCounterPrefix = "__glc_prof.";
+const char *ProfileWriterName = "__glc_prof_write";
+
+static const char *DefaultProfile = "default.glcprof";
+
+typedef std::map<std::string, std::vector<uint64_t> > ProfileMap;
+
+// Writes one "function: c0, c1, ..." line per counter array through the C
+// library, so the module needs nothing from glc at run time
+void EmitProfileWriter(llvm::Module *mod) {
+    size_t prefixLen = strlen(ProfileCounterPrefix);
+    std::vector<llvm::GlobalVariable*> arrays;
+    for ( llvm::Module::global_iterator g = mod->global_begin(); g != mod->global_end(); g++ )
+        if ( g->getName().startswith(ProfileCounterPrefix) && !g->isDeclaration() )
+            arrays.push_back(&*g);
+
+    if ( arrays.empty() )
+        return;
+
+    const char *path = GetOptionForKey("profile-generate");
+    if ( strcmp(path, "1") == 0 )
+        path = DefaultProfile;
+
+    llvm::LLVMContext &con = mod->getContext();
+    llvm::Type *i8Ptr = llvm::Type::getInt8PtrTy(con);
+    llvm::Type *i32 = llvm::Type::getInt32Ty(con);
+    llvm::Type *fopenArgs[] = { i8Ptr, i8Ptr };
+    llvm::Constant *fopenFn =
+        mod->getOrInsertFunction("fopen", llvm::FunctionType::get(i8Ptr, fopenArgs, false));
+    llvm::Constant *fprintfFn =
+        mod->getOrInsertFunction("fprintf", llvm::FunctionType::get(i32, fopenArgs, true));
+    llvm::Constant *fcloseFn =
+        mod->getOrInsertFunction("fclose", llvm::FunctionType::get(i32, i8Ptr, false));
+
+    llvm::Function *writer =
+        llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getVoidTy(con), false),
+                               llvm::GlobalValue::ExternalLinkage, ProfileWriterName, mod);
+    llvm::BasicBlock *entry = llvm::BasicBlock::Create(con, "entry", writer);
+    llvm::BasicBlock *write = llvm::BasicBlock::Create(con, "PROFwrite", writer);
+    llvm::BasicBlock *done = llvm::BasicBlock::Create(con, "PROFdone", writer);
+
+    llvm::IRBuilder<> b(entry);
+    llvm::Value *file = b.CreateCall(fopenFn, { b.CreateGlobalStringPtr(path), b.CreateGlobalStringPtr("w") });
+    b.CreateCondBr(b.CreateIsNull(file), done, write);
+
+    b.SetInsertPoint(write);
+    llvm::Value *first = b.CreateGlobalStringPtr(" %llu");
+    llvm::Value *next = b.CreateGlobalStringPtr(", %llu");
+    for ( size_t i = 0; i < arrays.size(); i++ ) {
+        std::string function = arrays[i]->getName().substr(prefixLen).str();
+        b.CreateCall(fprintfFn, { file, b.CreateGlobalStringPtr(function + ":") });
+
+        unsigned size = llvm::cast<llvm::ArrayType>(arrays[i]->getValueType())->getNumElements();
+        for ( unsigned k = 0; k < size; k++ ) {
+            llvm::Value *count = b.CreateLoad(b.CreateConstInBoundsGEP2_32(arrays[i]->getValueType(), arrays[i], 0, k));
+            b.CreateCall(fprintfFn, { file, k == 0 ? first : next, count });
+        }
+        b.CreateCall(fprintfFn, { file, b.CreateGlobalStringPtr("\n") });
+    }
+    b.CreateCall(fcloseFn, file);
+    b.CreateBr(done);
+
+    b.SetInsertPoint(done);
+    b.CreateRetVoid();
+
+    llvm::appendToGlobalDtors(*mod, writer, 0);
+}
+
+static void ReadProfile(const char *path, ProfileMap &profile) {
+    FILE *f = fopen(path, "r");
+    if ( f == NULL )
+        Failure("Cannot read profile %s", path);
+
+    char line[8192];
+    int lineno = 0;
+    while ( fgets(line, sizeof(line), f) != NULL ) {
+        lineno++;
+        char *colon = strchr(line, ':');
+        if ( colon == NULL ) {
+            if ( strspn(line, " \t\r\n") != strlen(line) )
+                Failure("%s:%d: expected \"function: count, ...\"", path, lineno);
+            continue;
+        }
+        *colon = '\0';
+
+        std::vector<uint64_t> &counts = profile[line];
+        counts.clear();
+        char *p = colon + 1, *end;
+        while ( true ) {
+            uint64_t n = strtoull(p, &end, 10);
+            if ( end == p )
+                Failure("%s:%d: expected a count", path, lineno);
+            counts.push_back(n);
+
+            p = end + strspn(end, " \t\r\n");
+            if ( *p == '\0' )
+                break;
+            if ( *p++ != ',' )
+                Failure("%s:%d: expected ',' between counts", path, lineno);
+        }
+    }
+    fclose(f);
+}
+
+// The first caller reads the file; the -j workers may race to it, which
+// the function-local static makes safe
+static ProfileMap *LoadProfile() {
+    ProfileMap *profile = new ProfileMap;
+    ReadProfile(GetOptionForKey("profile-use"), *profile);
+    return profile;
+}
+
+const std::vector<uint64_t> *GetProfileCounts(const std::string &function) {
+    static ProfileMap *profile = LoadProfile();
+
+    ProfileMap::iterator it = profile->find(function);
+    return it == profile->end() ? NULL : &it->second;
+}
@@ -0,0 +1,61 @@
+/**
+ * File: profile.h
+ * ---------------
+ *  This file declares the block execution profile behind
+ *  -fprofile-generate[=<file>] and -fprofile-use=<file>.
+ *
+ *  With -fprofile-generate every function gets an array of 64-bit
+ *  counters, the external global __glc_prof.<function>, and the blocks
+ *  created for its entry and for its if, for, while and switch statements
+ *  each add one to their own counter. Blocks are numbered in the order
+ *  they are created, so the same source compiled with the same options
+ *  numbers them the same way; counter 0 is the function entry.
+ *
+ *  The module also gets "void __glc_prof_write()", which writes the
+ *  counters to the profile (default.glcprof unless a file is given) and
+ *  is listed in llvm.global_dtors, so a program linking the compiled
+ *  output writes the profile when it exits. glc --run calls it once the
+ *  shader has run. The profile is a text file with one line per function:
+ *
+ *     main: 1, 100, 100, 1
+ *
+ *  With -fprofile-use the counts become the function's entry count and
+ *  !prof branch weights on the branches and switches between those
+ *  blocks. A function missing from the profile, or with a different
+ *  number of blocks, is compiled without them (see -d profile). SPMD
+ *  (-spmd) functions are neither instrumented nor annotated.
+ */
+
+#ifndef _H_profile
+#define _H_profile
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "llvm/IR/Module.h"
+
+extern const char *ProfileCounterPrefix;
+extern const char *ProfileWriterName;
+
+/**
+ * Function: EmitProfileWriter()
+ * Usage: EmitProfileWriter(mod);
+ * ------------------------------
+ * Adds __glc_prof_write, which writes the counter arrays of mod to the
+ * file given with -fprofile-generate, and registers it as a destructor.
+ * Does nothing if mod has no counters.
+ */
+
+void EmitProfileWriter(llvm::Module *mod);
+
+/**
+ * Function: GetProfileCounts()
+ * Usage: const std::vector<uint64_t> *counts = GetProfileCounts("main");
+ * ----------------------------------------------------------------------
+ * Returns the block counts of function from the -fprofile-use file, or
+ * NULL if it has none. The file is read on the first call.
+ */
+
+const std::vector<uint64_t> *GetProfileCounts(const std::string &function);
+
+#endif
@@ -0,0 +1,15 @@
+int bounded(int k)
+{
+  int a[8];
+  int i;
+  int sum;
+
+  for ( i = 0; i < 8; i++ )
+    a[i] = i * 3;
+
+  sum = a[2];
+  for ( i = 0; i < 8; i += 2 )
+    sum += a[i];
+
+  return sum + a[k];
+}
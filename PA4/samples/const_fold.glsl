@@ -0,0 +1,10 @@
+int fold(int x)
+{
+  int a;
+  float f;
+
+  a = 2 * 3 + 1;
+  f = 1.5 * 4.0 - 2.0;
+
+  return x * a + 8 / 2 - 1;
+}
@@ -0,0 +1,22 @@
+const int scale = 2 * 3 + 1;
+const float half = 0.5;
+uniform float u;
+
+float constuni(int n)
+{
+  int i;
+  int k;
+  float sum;
+
+  sum = 0.0;
+  k = 0;
+  for ( i = 0; i < n; i += 1 ) {
+    sum += u * half;
+    k += scale;
+  }
+
+  if ( k == n * scale )
+    sum += 1.0;
+
+  return sum;
+}
@@ -0,0 +1,15 @@
+float a;
+float b;
+
+float logicalselect()
+{
+  float f;
+  f = 0.0;
+
+  if ( a > 1.0 && b < 2.0 )
+    f = 1.0;
+  if ( a < 1.0 || b > 2.0 )
+    f = f + 2.0;
+
+  return f;
+}
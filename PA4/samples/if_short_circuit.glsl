@@ -0,0 +1,21 @@
+int count;
+
+bool bump()
+{
+  count++;
+  return true;
+}
+
+int shortcircuit(int a)
+{
+  count = 0;
+
+  if ( a > 0 || bump() ) {
+    count += 10;
+  }
+  if ( a < 0 && bump() ) {
+    count += 100;
+  }
+
+  return count;
+}
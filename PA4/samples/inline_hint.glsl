@@ -0,0 +1,24 @@
+float sq(float x)
+{
+  return x * x;
+}
+
+#pragma noinline
+float cube(float x)
+{
+  return x * x * x;
+}
+
+#pragma inline
+float poly(float x)
+{
+  float s;
+
+  s = sq(x) + cube(x);
+  return s + 1.0;
+}
+
+float main()
+{
+  return poly(2.0) + sq(3.0);
+}
@@ -0,0 +1,12 @@
+vec4 v;
+float k;
+
+float loadcache(float f)
+{
+  float s;
+
+  s = v.x + v.y + v.z + k * k;
+  k = s;
+  s = s + k + v.w;
+  return s;
+}
@@ -0,0 +1,14 @@
+float looplocal(int n)
+{
+  int i;
+  float sum;
+
+  sum = 0.0;
+  for ( i = 0; i < n; i++ ) {
+    float t;
+    t = sum + 1.5;
+    sum = t;
+  }
+
+  return sum;
+}
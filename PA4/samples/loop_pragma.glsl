@@ -0,0 +1,26 @@
+float pragmatest(int a)
+{
+  int i;
+  float sum;
+
+  sum = 0.0;
+#pragma unroll(4)
+  for ( i = 0; i < a; i += 1 )
+    sum += 1.5;
+
+#pragma nounroll
+  while ( i > 0 ) {
+    sum += 1.0;
+    i -= 1;
+  }
+
+#pragma vectorize(4)
+#pragma unroll(2)
+  for ( i = 0; i < a; i += 1 ) {
+#pragma nounroll
+    for ( i = i; i < 2; i += 1 )
+      sum += 0.25;
+  }
+
+  return sum;
+}
@@ -0,0 +1,14 @@
+int skewed(int n)
+{
+  int i;
+  int hits;
+
+  hits = 0;
+  for ( i = 0; i < n; i++ ) {
+    if ( i > n - 5 )
+      hits += 10;
+    else
+      hits += 1;
+  }
+  return hits;
+}
@@ -0,0 +1,18 @@
+float g;
+
+#pragma noinline
+float scale(float x)
+{
+  return x * 2.0;
+}
+
+#pragma noinline
+float gain(float x)
+{
+  return x * g;
+}
+
+float purity(float x)
+{
+  return scale(x) + scale(x) + gain(x) + gain(x);
+}
@@ -0,0 +1,26 @@
+int spmd_divergent(int n)
+{
+  int i;
+  int sum;
+
+  if (n > 40)
+    return n;
+
+  sum = 0;
+  for (i = 0; i < n; i++) {
+    if (i == 3 * (i / 3))
+      continue;
+    if (i > 20)
+      break;
+    sum += i;
+  }
+
+  while (sum > 100) {
+    sum -= 7;
+  }
+
+  if (sum > 50)
+    return sum - n;
+
+  return sum;
+}
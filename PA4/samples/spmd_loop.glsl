@@ -0,0 +1,35 @@
+int calls;
+
+int bump(int x)
+{
+  calls++;
+  return x;
+}
+
+int spmd_loop(int n)
+{
+  int i;
+  int sum;
+
+  sum = 0;
+  calls = 0;
+  for (i = 0; i < 10; i++) {
+    if (i == 2)
+      continue;
+    if (i > n)
+      break;
+    if (i > 5 && bump(i) > 6)
+      sum += 100;
+    else
+      sum += i;
+  }
+
+  while (sum > 20) {
+    sum -= 7;
+  }
+
+  if (sum > 15)
+    return sum + calls;
+
+  return 0;
+}
@@ -0,0 +1,279 @@
+int dispatch(int op)
+{
+   int r;
+   r = 0;
+
+   switch( op ) {
+     case 0: {r += 11; break;}
+     case 1: {r += 48; break;}
+     case 2: {r += 85; break;}
+     case 3: {r += 21; break;}
+     case 4: {r += 58; break;}
+     case 5: {r += 95; break;}
+     case 6: {r += 31; break;}
+     case 7: {r += 68; break;}
+     case 8: {r += 4; break;}
+     case 9: {r += 41; break;}
+     case 10: {r += 78; break;}
+     case 11: {r += 14; break;}
+     case 12: {r += 51; break;}
+     case 13: {r += 88; break;}
+     case 14: {r += 24; break;}
+     case 15: {r += 61;}
+     case 16: {r += 98; break;}
+     case 17: {r += 34; break;}
+     case 18: {r += 71; break;}
+     case 19: {r += 7; break;}
+     case 20: {r += 44; break;}
+     case 21: {r += 81; break;}
+     case 22: {r += 17; break;}
+     case 23: {r += 54; break;}
+     case 24: {r += 91; break;}
+     case 25: {r += 27; break;}
+     case 26: {r += 64; break;}
+     case 27: {r += 0; break;}
+     case 28: {r += 37; break;}
+     case 29: {r += 74; break;}
+     case 30: {r += 10; break;}
+     case 31: {r += 47;}
+     case 32: {r += 84; break;}
+     case 33: {r += 20; break;}
+     case 34: {r += 57; break;}
+     case 35: {r += 94; break;}
+     case 36: {r += 30; break;}
+     case 37: {r += 67; break;}
+     case 38: {r += 3; break;}
+     case 39: {r += 40; break;}
+     case 40: {r += 77; break;}
+     case 41: {r += 13; break;}
+     case 42: {r += 50; break;}
+     case 43: {r += 87; break;}
+     case 44: {r += 23; break;}
+     case 45: {r += 60; break;}
+     case 46: {r += 97; break;}
+     case 47: {r += 33;}
+     case 48: {r += 70; break;}
+     case 49: {r += 6; break;}
+     case 50: {r += 43; break;}
+     case 51: {r += 80; break;}
+     case 52: {r += 16; break;}
+     case 53: {r += 53; break;}
+     case 54: {r += 90; break;}
+     case 55: {r += 26; break;}
+     case 56: {r += 63; break;}
+     case 57: {r += 100; break;}
+     case 58: {r += 36; break;}
+     case 59: {r += 73; break;}
+     case 60: {r += 9; break;}
+     case 61: {r += 46; break;}
+     case 62: {r += 83; break;}
+     case 63: {r += 19;}
+     case 64: {r += 56; break;}
+     case 65: {r += 93; break;}
+     case 66: {r += 29; break;}
+     case 67: {r += 66; break;}
+     case 68: {r += 2; break;}
+     case 69: {r += 39; break;}
+     case 70: {r += 76; break;}
+     case 71: {r += 12; break;}
+     case 72: {r += 49; break;}
+     case 73: {r += 86; break;}
+     case 74: {r += 22; break;}
+     case 75: {r += 59; break;}
+     case 76: {r += 96; break;}
+     case 77: {r += 32; break;}
+     case 78: {r += 69; break;}
+     case 79: {r += 5;}
+     case 80: {r += 42; break;}
+     case 81: {r += 79; break;}
+     case 82: {r += 15; break;}
+     case 83: {r += 52; break;}
+     case 84: {r += 89; break;}
+     case 85: {r += 25; break;}
+     case 86: {r += 62; break;}
+     case 87: {r += 99; break;}
+     case 88: {r += 35; break;}
+     case 89: {r += 72; break;}
+     case 90: {r += 8; break;}
+     case 91: {r += 45; break;}
+     case 92: {r += 82; break;}
+     case 93: {r += 18; break;}
+     case 94: {r += 55; break;}
+     case 95: {r += 92;}
+     case 96: {r += 28; break;}
+     case 97: {r += 65; break;}
+     case 98: {r += 1; break;}
+     case 99: {r += 38; break;}
+     case 100: {r += 75; break;}
+     case 101: {r += 11; break;}
+     case 102: {r += 48; break;}
+     case 103: {r += 85; break;}
+     case 104: {r += 21; break;}
+     case 105: {r += 58; break;}
+     case 106: {r += 95; break;}
+     case 107: {r += 31; break;}
+     case 108: {r += 68; break;}
+     case 109: {r += 4; break;}
+     case 110: {r += 41; break;}
+     case 111: {r += 78;}
+     case 112: {r += 14; break;}
+     case 113: {r += 51; break;}
+     case 114: {r += 88; break;}
+     case 115: {r += 24; break;}
+     case 116: {r += 61; break;}
+     case 117: {r += 98; break;}
+     case 118: {r += 34; break;}
+     case 119: {r += 71; break;}
+     case 120: {r += 7; break;}
+     case 121: {r += 44; break;}
+     case 122: {r += 81; break;}
+     case 123: {r += 17; break;}
+     case 124: {r += 54; break;}
+     case 125: {r += 91; break;}
+     case 126: {r += 27; break;}
+     case 127: {r += 64;}
+     case 128: {r += 0; break;}
+     case 129: {r += 37; break;}
+     case 130: {r += 74; break;}
+     case 131: {r += 10; break;}
+     case 132: {r += 47; break;}
+     case 133: {r += 84; break;}
+     case 134: {r += 20; break;}
+     case 135: {r += 57; break;}
+     case 136: {r += 94; break;}
+     case 137: {r += 30; break;}
+     case 138: {r += 67; break;}
+     case 139: {r += 3; break;}
+     case 140: {r += 40; break;}
+     case 141: {r += 77; break;}
+     case 142: {r += 13; break;}
+     case 143: {r += 50;}
+     case 144: {r += 87; break;}
+     case 145: {r += 23; break;}
+     case 146: {r += 60; break;}
+     case 147: {r += 97; break;}
+     case 148: {r += 33; break;}
+     case 149: {r += 70; break;}
+     case 150: {r += 6; break;}
+     case 151: {r += 43; break;}
+     case 152: {r += 80; break;}
+     case 153: {r += 16; break;}
+     case 154: {r += 53; break;}
+     case 155: {r += 90; break;}
+     case 156: {r += 26; break;}
+     case 157: {r += 63; break;}
+     case 158: {r += 100; break;}
+     case 159: {r += 36;}
+     case 160: {r += 73; break;}
+     case 161: {r += 9; break;}
+     case 162: {r += 46; break;}
+     case 163: {r += 83; break;}
+     case 164: {r += 19; break;}
+     case 165: {r += 56; break;}
+     case 166: {r += 93; break;}
+     case 167: {r += 29; break;}
+     case 168: {r += 66; break;}
+     case 169: {r += 2; break;}
+     case 170: {r += 39; break;}
+     case 171: {r += 76; break;}
+     case 172: {r += 12; break;}
+     case 173: {r += 49; break;}
+     case 174: {r += 86; break;}
+     case 175: {r += 22;}
+     case 176: {r += 59; break;}
+     case 177: {r += 96; break;}
+     case 178: {r += 32; break;}
+     case 179: {r += 69; break;}
+     case 180: {r += 5; break;}
+     case 181: {r += 42; break;}
+     case 182: {r += 79; break;}
+     case 183: {r += 15; break;}
+     case 184: {r += 52; break;}
+     case 185: {r += 89; break;}
+     case 186: {r += 25; break;}
+     case 187: {r += 62; break;}
+     case 188: {r += 99; break;}
+     case 189: {r += 35; break;}
+     case 190: {r += 72; break;}
+     case 191: {r += 8;}
+     case 192: {r += 45; break;}
+     case 193: {r += 82; break;}
+     case 194: {r += 18; break;}
+     case 195: {r += 55; break;}
+     case 196: {r += 92; break;}
+     case 197: {r += 28; break;}
+     case 198: {r += 65; break;}
+     case 199: {r += 1; break;}
+     case 200: {r += 38; break;}
+     case 201: {r += 75; break;}
+     case 202: {r += 11; break;}
+     case 203: {r += 48; break;}
+     case 204: {r += 85; break;}
+     case 205: {r += 21; break;}
+     case 206: {r += 58; break;}
+     case 207: {r += 95;}
+     case 208: {r += 31; break;}
+     case 209: {r += 68; break;}
+     case 210: {r += 4; break;}
+     case 211: {r += 41; break;}
+     case 212: {r += 78; break;}
+     case 213: {r += 14; break;}
+     case 214: {r += 51; break;}
+     case 215: {r += 88; break;}
+     case 216: {r += 24; break;}
+     case 217: {r += 61; break;}
+     case 218: {r += 98; break;}
+     case 219: {r += 34; break;}
+     case 220: {r += 71; break;}
+     case 221: {r += 7; break;}
+     case 222: {r += 44; break;}
+     case 223: {r += 81;}
+     case 224: {r += 17; break;}
+     case 225: {r += 54; break;}
+     case 226: {r += 91; break;}
+     case 227: {r += 27; break;}
+     case 228: {r += 64; break;}
+     case 229: {r += 0; break;}
+     case 230: {r += 37; break;}
+     case 231: {r += 74; break;}
+     case 232: {r += 10; break;}
+     case 233: {r += 47; break;}
+     case 234: {r += 84; break;}
+     case 235: {r += 20; break;}
+     case 236: {r += 57; break;}
+     case 237: {r += 94; break;}
+     case 238: {r += 30; break;}
+     case 239: {r += 67;}
+     case 240: {r += 3; break;}
+     case 241: {r += 40; break;}
+     case 242: {r += 77; break;}
+     case 243: {r += 13; break;}
+     case 244: {r += 50; break;}
+     case 245: {r += 87; break;}
+     case 246: {r += 23; break;}
+     case 247: {r += 60; break;}
+     case 248: {r += 97; break;}
+     case 249: {r += 33; break;}
+     case 250: {r += 70; break;}
+     case 251: {r += 6; break;}
+     case 252: {r += 43; break;}
+     case 253: {r += 80; break;}
+     case 254: {r += 16; break;}
+     case 255: {r += 53;}
+     default: {r = 0 - 1; break;}
+   }
+
+   return r;
+}
+
+int switchbench(int n)
+{
+   int i;
+   int sum;
+
+   sum = 0;
+   for ( i = 0; i < n; i += 1 )
+     sum += dispatch(i - (i / 256) * 256);
+
+   return sum;
+}
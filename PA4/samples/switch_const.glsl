@@ -0,0 +1,20 @@
+int sparse(int a)
+{
+   int r;
+   r = 0;
+
+   switch( a ) {
+     case 7: {r = 1; break;}
+     case 1000: {r = 2;}
+     case 0 - 40: {r = r + 3; break;}
+     default: {r = 4; break;}
+   }
+
+   switch( 2 * 500 ) {
+     case 7: {r = r + 10; break;}
+     case 1000: {r = r + 20;}
+     default: {r = r + 30; break;}
+   }
+
+   return r;
+}
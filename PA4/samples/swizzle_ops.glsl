@@ -0,0 +1,12 @@
+vec4 v;
+vec4 w;
+
+float swizzle(float f)
+{
+  v.zx += w.xy;
+  v.yw *= f;
+  v.xyzw -= w.wzyx;
+  v.x++;
+
+  return v.x + v.y + v.z + v.w;
+}
@@ -0,0 +1,21 @@
+vec2 p;
+vec2 q;
+float total;
+
+float side(float x)
+{
+  total += x;
+  return x;
+}
+
+float ternary(float a)
+{
+  vec2 v;
+  float f;
+
+  total = 0.0;
+  v = a > 1.0 ? p : q;
+  f = a < 1.0 ? side(1.0) : side(2.0);
+
+  return v.x + v.y + f + total;
+}
@@ -0,0 +1,8 @@
+float ternary_cost(float a)
+{
+  float f;
+
+  f = a > 1.0 ? a * a * a * a : a + 1.0;
+
+  return f;
+}
@@ -0,0 +1,10 @@
+int unary_neg(int a)
+{
+  int b;
+  int c;
+
+  b = -a;
+  c = +a;
+
+  return a + b + c + -5;
+}
@@ -0,0 +1,13 @@
+vec3 v;
+
+float splat(float f)
+{
+  vec3 a;
+
+  a = v * f;
+  a += 1.5;
+  a++;
+  a = 2.0 - a;
+
+  return a.x + a.y + a.z;
+}
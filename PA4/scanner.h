@@ -15,9 +15,10 @@
 extern char *yytext;      // Text of lexeme just scanned
 
 
-int yylex();              // Defined in the generated lex.yy.c file
+int yylex();              // Defined in scanner.l
 
 void InitScanner();                 // Defined in scanner.l user subroutines
+void ScanFromString(const char *text, int len); // ditto
 const char *GetLineNumbered(int n); // ditto
  
 #endif
@@ -0,0 +1,78 @@
+/* File: stats.cc
+ * --------------
+ * Implementation of the --stats=json IR statistics.
+ */
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include "stats.h"
+#include "utility.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+struct FunctionStats {
+    int blocks, instrs;
+    int allocas, loads, stores;
+    int extracts, inserts;
+    std::map<std::string, int> opcodes;     // sorted, so the output is stable
+};
+
+static FunctionStats CountFunction(llvm::Function &func) {
+    FunctionStats stats = FunctionStats();
+
+    for ( llvm::Function::iterator bb = func.begin(); bb != func.end(); bb++ ) {
+        stats.blocks++;
+        for ( llvm::BasicBlock::iterator inst = bb->begin(); inst != bb->end(); inst++ ) {
+            stats.instrs++;
+            stats.opcodes[inst->getOpcodeName()]++;
+
+            switch ( inst->getOpcode() ) {
+              case llvm::Instruction::Alloca:         stats.allocas++;  break;
+              case llvm::Instruction::Load:           stats.loads++;    break;
+              case llvm::Instruction::Store:          stats.stores++;   break;
+              case llvm::Instruction::ExtractElement: stats.extracts++; break;
+              case llvm::Instruction::InsertElement:  stats.inserts++;  break;
+              default: break;
+            }
+        }
+    }
+    return stats;
+}
+
+static const char *DefaultStatsFile = "stats.json";
+
+void PrintModuleStats(llvm::Module *mod) {
+    const char *path = GetOptionForKey("stats-file");
+    if ( path == NULL )
+        path = DefaultStatsFile;
+
+    FILE *out = fopen(path, "w");
+    if ( out == NULL )
+        Failure("Cannot write statistics to %s", path);
+
+    fprintf(out, "{\"module\": \"%s\", \"functions\": [", mod->getModuleIdentifier().c_str());
+
+    bool first = true;
+    for ( llvm::Module::iterator f = mod->begin(); f != mod->end(); f++ ) {
+        if ( f->isDeclaration() )
+            continue;
+
+        FunctionStats stats = CountFunction(*f);
+        fprintf(out, "%s\n  {\"name\": \"%s\", \"basic_blocks\": %d, \"instructions\": %d, "
+                "\"allocas\": %d, \"loads\": %d, \"stores\": %d, "
+                "\"extractelement\": %d, \"insertelement\": %d, \"opcodes\": {",
+                first ? "" : ",", f->getName().str().c_str(), stats.blocks, stats.instrs,
+                stats.allocas, stats.loads, stats.stores, stats.extracts, stats.inserts);
+
+        for ( std::map<std::string, int>::iterator op = stats.opcodes.begin();
+              op != stats.opcodes.end(); op++ )
+            fprintf(out, "%s\"%s\": %d", op == stats.opcodes.begin() ? "" : ", ",
+                    op->first.c_str(), op->second);
+        fprintf(out, "}}");
+        first = false;
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+}
@@ -0,0 +1,31 @@
+/**
+ * File: stats.h
+ * -------------
+ *  This file declares the per-function IR statistics behind --stats=json.
+ *
+ *  For every function defined in the module the report gives its number
+ *  of basic blocks and instructions, the instruction count per opcode, and
+ *  separately the allocas, loads, stores and extract/insertelement
+ *  instructions, which are the first to grow when vector and swizzle code
+ *  gets worse. The numbers are taken after optimization, i.e. from the IR
+ *  that is written out or run. The report goes to stats.json, or to the
+ *  file given with --stats-file, so it stays apart from the output module
+ *  and from the -ftime-report on stderr.
+ */
+
+#ifndef _H_stats
+#define _H_stats
+
+#include "llvm/IR/Module.h"
+
+/**
+ * Function: PrintModuleStats()
+ * Usage: PrintModuleStats(mod);
+ * -----------------------------
+ * Writes the statistics of every defined function in mod, in module
+ * order, as a JSON document to the statistics file.
+ */
+
+void PrintModuleStats(llvm::Module *mod);
+
+#endif
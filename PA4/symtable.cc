@@ -4,6 +4,7 @@
  */
 
 #include "symtable.h"
+#include "ast_decl.h"
 
 // ScopedTable Class Implementation
 ScopedTable::ScopedTable() {
@@ -43,6 +44,7 @@ Symbol* ScopedTable::find(const char *name) {
 // SymbolTable Class Implementation
 SymbolTable::SymbolTable() {
     currScope = 0;
+    externals = NULL;
     tables.push_back(new ScopedTable());
 }
 
@@ -80,6 +82,14 @@ Symbol* SymbolTable::findall(const char *name)  {
             return sym;
     }
 
+    if (externals != NULL) {
+        DeclMap::const_iterator ext = externals->find(name);
+        if (ext != externals->end()) {
+            ext->second->EmitDeclaration();
+            return tables[0]->find(name);
+        }
+    }
+
     return NULL;
 }
 
@@ -39,13 +39,15 @@ struct Symbol {
   Decl *decl;
   EntryKind kind;
   llvm::Value *value;
+  bool uniform;         // a uniform variable, which may not be assigned
 
-  Symbol() : name(NULL), decl(NULL), kind(E_VarDecl), value(NULL) {}
+  Symbol() : name(NULL), decl(NULL), kind(E_VarDecl), value(NULL), uniform(false) {}
   Symbol(char *n, Decl *d, EntryKind k, llvm::Value *v = NULL) :
         name(n),
         decl(d),
         kind(k),
-        value(v) {}
+        value(v),
+        uniform(false) {}
 };
 
 struct lessStr {
@@ -68,9 +70,12 @@ class ScopedTable {
     Symbol *find(const char *name);
 };
    
+typedef map<const char *, Decl *, lessStr> DeclMap;
+
 class SymbolTable {
   std::vector<ScopedTable *> tables;
   int currScope;
+  const DeclMap *externals;
  
   public:
     SymbolTable();
@@ -79,7 +84,14 @@ class SymbolTable {
     void push();
     void pop();
 
+    // A name not found in any scope is looked up in externals and, if it
+    // is there, declared in the current module and added to the global
+    // scope. The parallel code generator uses this so the module of each
+    // function only declares the globals and functions it refers to.
+    void setExternals(const DeclMap *ext) { externals = ext; }
+
     void insert(Symbol &sym);
+    void insertGlobal(Symbol &sym) { tables[0]->insert(sym); }
     void remove(Symbol &sym);
     Symbol *find(const char *name);
     Symbol *findall(const char *name);
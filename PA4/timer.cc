@@ -0,0 +1,179 @@
+/* File: timer.cc
+ * --------------
+ * Implementation of the -ftime-report phase timers.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <string>
+#include <vector>
+#include "timer.h"
+#include "utility.h"
+
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+struct Phase {
+    const char *name;
+    Phase *parent;
+    std::vector<Phase*> children;
+    int calls;
+    double wall, cpu;           // seconds, summed over all calls
+    long peakRss;               // KB, when the phase last ended
+    double startWall, startCpu;
+    bool accumulated;           // wall time only, from AddPhaseTime
+};
+
+static Phase root = { "", NULL };
+static Phase *current = &root;
+
+static double Now(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Looked up once; yylex asks for every token
+bool TimeReportEnabled() {
+    static int enabled = -1;
+    if (enabled == -1)
+        enabled = (GetOptionForKey("time-report") != NULL);
+    return enabled;
+}
+
+static Phase *GetChild(const char *name) {
+    for (size_t i = 0; i < current->children.size(); i++)
+        if (strcmp(current->children[i]->name, name) == 0)
+            return current->children[i];
+
+    Phase *phase = new Phase();
+    phase->name = name;
+    phase->parent = current;
+    current->children.push_back(phase);
+    return phase;
+}
+
+double PhaseClock() {
+    return Now(CLOCK_MONOTONIC);
+}
+
+// One clock read per call; the CPU clock and getrusage are left to the
+// running phase, which is entered once
+void AddPhaseTime(const char *name, double start) {
+    if (!TimeReportEnabled())
+        return;
+
+    Phase *phase = GetChild(name);
+    phase->accumulated = true;
+    phase->calls++;
+    phase->wall += Now(CLOCK_MONOTONIC) - start;
+}
+
+void StartPhase(const char *name) {
+    if (!TimeReportEnabled())
+        return;
+
+    Phase *phase = GetChild(name);
+    phase->calls++;
+    phase->startWall = Now(CLOCK_MONOTONIC);
+    phase->startCpu = Now(CLOCK_PROCESS_CPUTIME_ID);
+    current = phase;
+}
+
+void EndPhase() {
+    if (!TimeReportEnabled() || current == &root)
+        return;
+
+    current->wall += Now(CLOCK_MONOTONIC) - current->startWall;
+    current->cpu += Now(CLOCK_PROCESS_CPUTIME_ID) - current->startCpu;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    current->peakRss = usage.ru_maxrss;
+
+    current = current->parent;
+}
+
+static double SelfTime(Phase *p) {
+    double self = p->wall;
+    for (size_t i = 0; i < p->children.size(); i++)
+        self -= p->children[i]->wall;
+    return self;
+}
+
+static void PrintTable(Phase *p, int depth) {
+    if (p->accumulated)
+        fprintf(stderr, "%*s%-*s %8d %11.3f %11.3f %11s %12s\n", depth*2, "", 24 - depth*2,
+                p->name, p->calls, p->wall * 1e3, SelfTime(p) * 1e3, "-", "-");
+    else
+        fprintf(stderr, "%*s%-*s %8d %11.3f %11.3f %11.3f %12ld\n", depth*2, "", 24 - depth*2,
+                p->name, p->calls, p->wall * 1e3, SelfTime(p) * 1e3, p->cpu * 1e3, p->peakRss);
+
+    for (size_t i = 0; i < p->children.size(); i++)
+        PrintTable(p->children[i], depth+1);
+}
+
+static void PrintJSON(Phase *p, int depth) {
+    fprintf(stderr, "%*s{\"name\": \"%s\", \"calls\": %d, \"wall_ms\": %.3f, \"self_ms\": %.3f, ",
+            depth*2, "", p->name, p->calls, p->wall * 1e3, SelfTime(p) * 1e3);
+    if (p->accumulated)
+        fprintf(stderr, "\"cpu_ms\": null, \"peak_rss_kb\": null, \"children\": [");
+    else
+        fprintf(stderr, "\"cpu_ms\": %.3f, \"peak_rss_kb\": %ld, \"children\": [",
+                p->cpu * 1e3, p->peakRss);
+
+    for (size_t i = 0; i < p->children.size(); i++) {
+        fprintf(stderr, "%s\n", i == 0 ? "" : ",");
+        PrintJSON(p->children[i], depth+1);
+    }
+    fprintf(stderr, "]}");
+}
+
+static void PrintJSONString(const std::string &text) {
+    fputc('"', stderr);
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"' || text[i] == '\\')
+            fprintf(stderr, "\\%c", text[i]);
+        else if (text[i] == '\n')
+            fprintf(stderr, "\\n");
+        else
+            fputc(text[i], stderr);
+    }
+    fputc('"', stderr);
+}
+
+void PrintTimeReport() {
+    if (!TimeReportEnabled())
+        return;
+
+    // LLVM keeps its pass timers (enabled by Optimize) in timer groups
+    std::string passes;
+    llvm::raw_string_ostream os(passes);
+    llvm::TimerGroup::printAll(os);
+    os.flush();
+
+    if (strcmp(GetOptionForKey("time-report"), "json") == 0) {
+        fprintf(stderr, "{\"phases\": [");
+        for (size_t i = 0; i < root.children.size(); i++) {
+            fprintf(stderr, "%s\n", i == 0 ? "" : ",");
+            PrintJSON(root.children[i], 1);
+        }
+        fprintf(stderr, "],\n \"llvm_passes\": ");
+        PrintJSONString(passes);
+        fprintf(stderr, "}\n");
+        return;
+    }
+
+    fprintf(stderr, "===-------------------------------------------------------------------------===\n");
+    fprintf(stderr, "                          glc compile time report\n");
+    fprintf(stderr, "===-------------------------------------------------------------------------===\n");
+    fprintf(stderr, "%-24s %8s %11s %11s %11s %12s\n",
+            "phase", "calls", "wall(ms)", "self(ms)", "cpu(ms)", "peakRSS(KB)");
+    for (size_t i = 0; i < root.children.size(); i++)
+        PrintTable(root.children[i], 0);
+
+    if (!passes.empty())
+        fprintf(stderr, "\n%s", passes.c_str());
+}
@@ -0,0 +1,78 @@
+/**
+ * File: timer.h
+ * -------------
+ *  This file defines the phase timers behind -ftime-report.
+ *
+ *  Phases nest: a phase started while another one is running becomes its
+ *  child, and a phase entered several times under the same parent is
+ *  accumulated into one entry. For every phase the report gives the
+ *  number of calls, the wall and CPU time spent in it and in its children,
+ *  the wall time not covered by a child ("self"), and the peak resident
+ *  set size of the process when the phase last ended. Code that runs too
+ *  often for that (yylex runs once per token) adds its wall time with
+ *  AddPhaseTime instead, and reports calls and wall time only.
+ *
+ *  -ftime-report prints a table to stderr, -ftime-report=json prints the
+ *  same tree as JSON. When optimizing, LLVM's per-pass timings follow.
+ *  Without the flag StartPhase/EndPhase return immediately.
+ */
+
+#ifndef _H_timer
+#define _H_timer
+
+/**
+ * Function: StartPhase(), EndPhase()
+ * Usage: StartPhase("parse"); yyparse(); EndPhase();
+ * --------------------------------------------------
+ * Starts a phase as a child of the running one; EndPhase ends the most
+ * recently started phase. Name must stay valid until the report.
+ */
+
+void StartPhase(const char *name);
+void EndPhase();
+
+/**
+ * Function: PhaseClock(), AddPhaseTime()
+ * Usage: double start = PhaseClock(); ScanToken(); AddPhaseTime("lex", start);
+ * -----------------------------------------------------------------------------
+ * Adds one call and the wall time since start to the named child of the
+ * running phase, reading a single clock.
+ */
+
+double PhaseClock();
+void AddPhaseTime(const char *name, double start);
+
+/**
+ * Function: TimeReportEnabled()
+ * Usage: if (TimeReportEnabled()) ...
+ * -----------------------------------
+ * Returns true if -ftime-report was given.
+ */
+
+bool TimeReportEnabled();
+
+/**
+ * Function: PrintTimeReport()
+ * Usage: PrintTimeReport();
+ * -------------------------
+ * Prints the phase tree (and LLVM's pass timings) to stderr if
+ * -ftime-report was given.
+ */
+
+void PrintTimeReport();
+
+/**
+ * Class: PhaseTimer
+ * -----------------
+ * Times the enclosing scope as a phase.
+ *
+ *    { PhaseTimer t("mem2reg"); irgen->PromoteToRegisters(); }
+ */
+
+class PhaseTimer {
+  public:
+    PhaseTimer(const char *name) { StartPhase(name); }
+    ~PhaseTimer() { EndPhase(); }
+};
+
+#endif
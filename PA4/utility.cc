@@ -7,16 +7,24 @@
 #include "utility.h"
 #include <stdarg.h>
 #include <string.h>
+#include <mutex>
 #include <vector>
 using std::vector;
 
 static vector<const char*> debugKeys;
+static vector<const char*> optionKeys;
+static vector<const char*> optionValues;
 static const int BufferSize = 2048;
 
+// A -j worker may fail while another one does; the first to get here
+// prints its message and aborts, the others wait
+static std::mutex failureLock;
+
 void Failure(const char *format, ...) {
   va_list args;
   char errbuf[BufferSize];
-  
+
+  failureLock.lock();
   va_start(args, format);
   vsprintf(errbuf, format, args);
   va_end(args);
@@ -37,6 +45,10 @@ bool IsDebugOn(const char *key) {
   return (IndexOf(key) != -1);
 }
 
+bool AnyDebugOn() {
+  return !debugKeys.empty();
+}
+
 void SetDebugForKey(const char *key, bool value) {
   int k = IndexOf(key);
   if (!value && k != -1)
@@ -58,19 +70,138 @@ void PrintDebug(const char *key, const char *format, ...) {
   printf("+++ (%s): %s%s", key, buf, buf[strlen(buf)-1] != '\n'? "\n" : "");
 }
 
+int IndexOfOption(const char *key) {
+  for (unsigned int i = 0; i < optionKeys.size(); i++)
+    if (!strcmp(optionKeys[i], key))
+      return i;
+
+  return -1;
+}
+
+void SetOptionForKey(const char *key, const char *value) {
+  int k = IndexOfOption(key);
+  if (k != -1)
+    optionValues[k] = value;
+  else {
+    optionKeys.push_back(key);
+    optionValues.push_back(value);
+  }
+}
+
+const char *GetOptionForKey(const char *key) {
+  int k = IndexOfOption(key);
+  return (k == -1 ? NULL : optionValues[k]);
+}
+
+int NumOptions() {
+  return optionKeys.size();
+}
+
+const char *GetNthOptionKey(int n) {
+  return optionKeys[n];
+}
+
+const char *GetNthOptionValue(int n) {
+  return optionValues[n];
+}
+
+int GetOptLevel() {
+  const char *level = GetOptionForKey("O");
+  return (level == NULL ? 0 : atoi(level));
+}
+
+static void Usage(int argc, char *argv[]) {
+  printf("Incorrect Use:   ");
+  for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
+  printf("\n");
+  printf("Correct Usage:   [-O0|-O1|-O2|-O3] [-j<threads>] [-march=native|<cpu>] [-spmd=<lanes>] [-emit=bc|ll|asm|obj] [-o <file>] [--run <file.dat> [--bench <invocations>]] [-g] [-fbounds-check] [-fprofile-generate[=<file>]|-fprofile-use=<file>] [-ftime-report[=json]] [--stats=json [--stats-file <file>]] [--cache <dir> [--cache-size <MB>]] [-d <debug-key-1> <debug-key-2> ...] \n");
+  exit(2);
+}
+
 void ParseCommandLine(int argc, char *argv[]) {
   if (argc == 1)
     return;
-  
-  if (strcmp(argv[1], "-d") != 0) { // first arg is not -d
-    printf("Incorrect Use:   ");
-    for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
-    printf("\n");
-    printf("Correct Usage:   -d <debug-key-1> <debug-key-2> ... \n");
-    exit(2);
-  }
 
-  for (int i = 2; i < argc; i++)
-    SetDebugForKey(argv[i], true);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-d") == 0) {
+      // every argument up to the next flag is a debug key
+      while (i+1 < argc && argv[i+1][0] != '-')
+        SetDebugForKey(argv[++i], true);
+    }
+    else if (strncmp(argv[i], "-O", 2) == 0) {
+      const char *level = argv[i] + 2;
+      if (strlen(level) != 1 || level[0] < '0' || level[0] > '3')
+        Usage(argc, argv);
+      SetOptionForKey("O", level);
+    }
+    else if (strncmp(argv[i], "-j", 2) == 0) {
+      if (atoi(argv[i] + 2) <= 0)
+        Usage(argc, argv);
+      SetOptionForKey("jobs", argv[i] + 2);
+    }
+    else if (strncmp(argv[i], "-spmd=", 6) == 0) {
+      // lanes must be a power of two so the mask fits a single integer
+      int lanes = atoi(argv[i] + 6);
+      if (lanes < 2 || lanes > 64 || (lanes & (lanes-1)) != 0)
+        Usage(argc, argv);
+      SetOptionForKey("spmd", argv[i] + 6);
+    }
+    else if (strncmp(argv[i], "-march=", 7) == 0 && argv[i][7] != '\0') {
+      SetOptionForKey("march", argv[i] + 7);
+    }
+    else if (strncmp(argv[i], "-emit=", 6) == 0) {
+      const char *kind = argv[i] + 6;
+      if (strcmp(kind, "bc") && strcmp(kind, "ll") && strcmp(kind, "asm") && strcmp(kind, "obj"))
+        Usage(argc, argv);
+      SetOptionForKey("emit", kind);
+    }
+    else if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+      SetOptionForKey("o", argv[++i]);
+    }
+    else if (strcmp(argv[i], "--run") == 0 && i+1 < argc) {
+      SetOptionForKey("run", argv[++i]);
+    }
+    else if (strcmp(argv[i], "--bench") == 0 && i+1 < argc) {
+      if (atoi(argv[i+1]) <= 0)
+        Usage(argc, argv);
+      SetOptionForKey("bench", argv[++i]);
+    }
+    else if (strcmp(argv[i], "-ftime-report") == 0) {
+      SetOptionForKey("time-report", "table");
+    }
+    else if (strcmp(argv[i], "-ftime-report=json") == 0) {
+      SetOptionForKey("time-report", "json");
+    }
+    else if (strcmp(argv[i], "-g") == 0) {
+      SetOptionForKey("debug", "1");
+    }
+    else if (strcmp(argv[i], "-fbounds-check") == 0) {
+      SetOptionForKey("bounds-check", "1");
+    }
+    else if (strcmp(argv[i], "-fprofile-generate") == 0) {
+      SetOptionForKey("profile-generate", "1");
+    }
+    else if (strncmp(argv[i], "-fprofile-generate=", 19) == 0 && argv[i][19] != '\0') {
+      SetOptionForKey("profile-generate", argv[i] + 19);
+    }
+    else if (strncmp(argv[i], "-fprofile-use=", 14) == 0 && argv[i][14] != '\0') {
+      SetOptionForKey("profile-use", argv[i] + 14);
+    }
+    else if (strcmp(argv[i], "--stats=json") == 0) {
+      SetOptionForKey("stats", "json");
+    }
+    else if (strcmp(argv[i], "--stats-file") == 0 && i+1 < argc) {
+      SetOptionForKey("stats-file", argv[++i]);
+    }
+    else if (strcmp(argv[i], "--cache") == 0 && i+1 < argc) {
+      SetOptionForKey("cache", argv[++i]);
+    }
+    else if (strcmp(argv[i], "--cache-size") == 0 && i+1 < argc) {
+      if (atoi(argv[i+1]) <= 0)
+        Usage(argc, argv);
+      SetOptionForKey("cache-size", argv[++i]);
+    }
+    else
+      Usage(argc, argv);
+  }
 }
-
@@ -73,12 +73,81 @@ void SetDebugForKey(const char *key, bool val);
 
 bool IsDebugOn(const char *key);
 
+/**
+ * Function: AnyDebugOn()
+ * Usage: if (AnyDebugOn()) ...
+ * ----------------------------
+ * Return true if debug printing is on for at least one key.
+ */
+
+bool AnyDebugOn();
+
+/**
+ * Function: SetOptionForKey()
+ * Usage: SetOptionForKey("O", "2");
+ * ---------------------------------
+ * Record the value of a compiler option. Called from ParseCommandLine
+ * for options such as -O2. Setting a key again replaces its value.
+ */
+
+void SetOptionForKey(const char *key, const char *value);
+
+/**
+ * Function: GetOptionForKey()
+ * Usage: const char *level = GetOptionForKey("O");
+ * ------------------------------------------------
+ * Return the value recorded for the given option key, or NULL if the
+ * option was not given on the command line.
+ */
+
+const char *GetOptionForKey(const char *key);
+
+/**
+ * Function: NumOptions(), GetNthOptionKey(), GetNthOptionValue()
+ * Usage: for (int i = 0; i < NumOptions(); i++) ... GetNthOptionKey(i) ...
+ * ------------------------------------------------------------------------
+ * Iterate over the recorded options in the order they were first set.
+ */
+
+int NumOptions();
+const char *GetNthOptionKey(int n);
+const char *GetNthOptionValue(int n);
+
+/**
+ * Function: GetOptLevel()
+ * Usage: if (GetOptLevel() > 1) ...
+ * ---------------------------------
+ * Return the optimization level (0-3) requested with -O<n>. Defaults
+ * to 0 when no -O flag was given.
+ */
+
+int GetOptLevel();
+
 /**
  * Function: ParseCommandLine
  * --------------------------
- * Turn on the debugging flags from the command line.  Verifies that
- * first argument is -d, and then interpret all the arguments that follow
- * as being flags to turn on.
+ * Turn on the debugging flags and options from the command line; called
+ * from main before anything else. The arguments following -d up to the
+ * next flag are debug keys to turn on. The options are:
+ *
+ *   -O0..-O3               optimization pipeline (key "O")
+ *   -j<threads>            parallel per-function code generation ("jobs")
+ *   -march=native|<cpu>    target CPU ("march")
+ *   -spmd=<lanes>          SPMD mode with 2..64 lanes ("spmd")
+ *   -emit=bc|ll|asm|obj    output kind ("emit"), -o <file> its file ("o")
+ *   --run <file.dat>       run in-process instead of writing output ("run"),
+ *   --bench <invocations>  also as a batch on the executor ("bench")
+ *   -g                     line tables ("debug")
+ *   -fbounds-check         array bounds checks ("bounds-check")
+ *   -fprofile-generate[=<file>], -fprofile-use=<file>
+ *                          block profiles ("profile-generate", "profile-use")
+ *   -ftime-report[=json]   phase timings ("time-report")
+ *   --stats=json           IR statistics ("stats"), --stats-file <file>
+ *                          their file ("stats-file")
+ *   --cache <dir>          compile cache ("cache"), --cache-size <MB> its
+ *                          limit ("cache-size")
+ *
+ * Anything else prints the usage and exits.
  */
 
 void ParseCommandLine(int argc, char *argv[]);